@@ -15,11 +15,23 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
   EventLoop eventloop {};
   FileDescriptor input { STDIN_FILENO };
   FileDescriptor output { STDOUT_FILENO };
-  ByteStream outbound { buffer_size };
-  ByteStream inbound { buffer_size };
+  ByteStream outbound { buffer_size, ByteStream::Storage::Chunked };
+  ByteStream inbound { buffer_size, ByteStream::Storage::Chunked };
   bool outbound_shutdown { false };
   bool inbound_shutdown { false };
 
+  // Refill each stream from its source only once it has drained to half full. The readers keep the default
+  // high watermark (one byte) so that interactive input is forwarded immediately.
+  outbound.writer().set_low_watermark( buffer_size / 2 );
+  inbound.writer().set_low_watermark( buffer_size / 2 );
+
+  // The streams report when they cross a watermark, so the rules' interest is a flag rather than a re-check.
+  bool outbound_writable {}, outbound_readable {}, inbound_writable {}, inbound_readable {};
+  outbound.writer().on_writable_change( [&]( bool writable ) { outbound_writable = writable; } );
+  outbound.reader().on_readable_change( [&]( bool readable ) { outbound_readable = readable; } );
+  inbound.writer().on_writable_change( [&]( bool writable ) { inbound_writable = writable; } );
+  inbound.reader().on_readable_change( [&]( bool readable ) { inbound_readable = readable; } );
+
   socket.set_blocking( false );
   input.set_blocking( false );
   output.set_blocking( false );
@@ -30,17 +42,13 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     input,
     Direction::In,
     [&] {
-      string data;
-      data.resize( outbound.writer().available_capacity() );
-      input.read( data );
-      outbound.writer().push( move( data ) );
+      outbound.writer().push_from( input );
       if ( input.eof() ) {
         outbound.writer().close();
       }
     },
     [&] {
-      return !outbound.has_error() and !inbound.has_error() and ( outbound.writer().available_capacity() > 0 )
-             and !outbound.writer().is_closed();
+      return outbound_writable and !inbound.has_error();
     },
     [&] { outbound.writer().close(); },
     [&] {
@@ -55,9 +63,7 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     socket,
     Direction::Out,
     [&] {
-      if ( outbound.reader().bytes_buffered() ) {
-        outbound.reader().pop( socket.write( outbound.reader().peek() ) );
-      }
+      outbound.reader().pop_into( socket );
       if ( outbound.reader().is_finished() ) {
         socket.shutdown( SHUT_WR );
         outbound_shutdown = true;
@@ -65,7 +71,7 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
       }
     },
     [&] {
-      return outbound.reader().bytes_buffered() or ( outbound.reader().is_finished() and not outbound_shutdown );
+      return outbound_readable or ( outbound.reader().is_finished() and not outbound_shutdown );
     },
     [&] { outbound.writer().close(); },
     [&] {
@@ -80,17 +86,13 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     socket,
     Direction::In,
     [&] {
-      string data;
-      data.resize( inbound.writer().available_capacity() );
-      socket.read( data );
-      inbound.writer().push( move( data ) );
+      inbound.writer().push_from( socket );
       if ( socket.eof() ) {
         inbound.writer().close();
       }
     },
     [&] {
-      return !inbound.has_error() and !outbound.has_error() and ( inbound.writer().available_capacity() > 0 )
-             and !inbound.writer().is_closed();
+      return inbound_writable and !outbound.has_error();
     },
     [&] { inbound.writer().close(); },
     [&] {
@@ -105,9 +107,7 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     output,
     Direction::Out,
     [&] {
-      if ( inbound.reader().bytes_buffered() ) {
-        inbound.reader().pop( output.write( inbound.reader().peek() ) );
-      }
+      inbound.reader().pop_into( output );
       if ( inbound.reader().is_finished() ) {
         output.close();
         inbound_shutdown = true;
@@ -116,7 +116,7 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
       }
     },
     [&] {
-      return inbound.reader().bytes_buffered() or ( inbound.reader().is_finished() and not inbound_shutdown );
+      return inbound_readable or ( inbound.reader().is_finished() and not inbound_shutdown );
     },
     [&] { inbound.writer().close(); },
     [&] {
@@ -35,6 +35,8 @@ void show_usage( const char* argv0, const char* msg )
 
        << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
+       << "   -c <algo>       Congestion control: none, newreno, cubic or bbr (none)\n\n"
+
        << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n\n"
 
        << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
@@ -89,6 +91,7 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
     } else if ( strncmp( "-w", args[curr], 3 ) == 0 ) {
       check_argc( args, curr, "ERROR: -w requires one argument." );
       c_fsm.recv_capacity = strtol( args[curr + 1], nullptr, 0 );
+      c_fsm.window_scale = c_fsm.recv_capacity > UINT16_MAX; // the window field alone cannot advertise more
       curr += 2;
 
     } else if ( strncmp( "-t", args[curr], 3 ) == 0 ) {
@@ -96,6 +99,24 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
       c_fsm.rt_timeout = strtol( args[curr + 1], nullptr, 0 );
       curr += 2;
 
+    } else if ( strncmp( "-c", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -c requires one argument." );
+      bool found = false;
+      for ( const auto algorithm : { CongestionControl::Algorithm::None,
+                                     CongestionControl::Algorithm::NewReno,
+                                     CongestionControl::Algorithm::Cubic,
+                                     CongestionControl::Algorithm::BBR } ) {
+        if ( CongestionControl::name( algorithm ) == args[curr + 1] ) {
+          c_fsm.congestion_control = algorithm;
+          found = true;
+        }
+      }
+      if ( !found ) {
+        show_usage( args[0], "ERROR: unknown congestion control algorithm." );
+        exit( 1 );
+      }
+      curr += 2;
+
     } else if ( strncmp( "-d", args[curr], 3 ) == 0 ) {
       check_argc( args, curr, "ERROR: -t requires one argument." );
       tundev = args[curr + 1];
@@ -158,8 +179,10 @@ int main( int argc, char** argv )
     }
 
     auto [c_fsm, c_filt, listen, tun_dev_name] = get_config( args );
-    LossyTCPOverIPv4MinnowSocket tcp_socket( LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>(
-      TCPOverIPv4OverTunFdAdapter( TunFD( tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name ) ) ) );
+    TunFD tun { tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name };
+    c_fsm.mtu = tun.mtu(); // segment to what the device carries (e.g., 8960-byte payloads with jumbo frames)
+    LossyTCPOverIPv4MinnowSocket tcp_socket(
+      LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>( TCPOverIPv4OverTunFdAdapter( move( tun ) ) ) );
 
     if ( listen ) {
       tcp_socket.listen_and_accept( c_fsm, c_filt );
@@ -23,6 +23,15 @@ ttest(byte_stream_one_write)
 ttest(byte_stream_two_writes)
 ttest(byte_stream_many_writes)
 ttest(byte_stream_stress_test)
+ttest(byte_stream_ring)
+ttest(byte_stream_chunked)
+ttest(byte_stream_spill)
+ttest(byte_stream_set_capacity)
+ttest(byte_stream_concurrent)
+ttest(byte_stream_fd)
+ttest(byte_stream_watermarks)
+
+ttest(buffer_pool)
 
 ttest(reassembler_single)
 ttest(reassembler_cap)
@@ -31,6 +40,8 @@ ttest(reassembler_dup)
 ttest(reassembler_holes)
 ttest(reassembler_overlapping)
 ttest(reassembler_win)
+ttest(reassembler_ring)
+ttest(reassembler_stats)
 
 ttest(wrapping_integers_cmp)
 ttest(wrapping_integers_wrap)
@@ -45,6 +56,9 @@ ttest(recv_reorder)
 ttest(recv_reorder_more)
 ttest(recv_close)
 ttest(recv_special)
+ttest(recv_autotune)
+ttest(recv_sack)
+ttest(recv_timestamps)
 
 ttest(send_connect)
 ttest(send_transmit)
@@ -53,6 +67,16 @@ ttest(send_ack)
 ttest(send_close)
 ttest(send_retx)
 ttest(send_extra)
+ttest(send_sack)
+ttest(send_congestion)
+ttest(send_rto)
+ttest(send_fast_retransmit)
+ttest(send_pacing)
+
+ttest(tcp_window_scale)
+ttest(tcp_mss)
+ttest(tcp_timestamps)
+ttest(tcp_delayed_ack)
 
 ttest(net_interface)
 
@@ -94,3 +118,6 @@ set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
 stest(reassembler_speed_test)
+stest(byte_stream_spill_speed_test)
+stest(tcp_sender_speed_test)
+set_property(TEST byte_stream_spill_speed_test PROPERTY TIMEOUT 120) # pushes 10 GiB through a temporary file
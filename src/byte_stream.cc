@@ -1,73 +1,431 @@
 #include "byte_stream.hh"
+#include "file_descriptor.hh"
+
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+#include <utility>
 
 using namespace std;
 
-ByteStream::ByteStream( uint64_t capacity ) : buffer_ {}, capacity_ { capacity } {}
+namespace {
+
+// Call `f( offset, len )` for the ring positions of stream bytes [from, to), split where the ring wraps.
+void for_each_ring_range( uint64_t capacity, uint64_t from, uint64_t to, const auto& f )
+{
+  while ( from < to ) {
+    const uint64_t offset = from % capacity;
+    const uint64_t len = min( to - from, capacity - offset );
+    f( offset, len );
+    from += len;
+  }
+}
+
+} // namespace
+
+ByteStream::ByteStream( uint64_t capacity, Storage storage, uint64_t spill_window )
+  : storage_( storage )
+  , buffer_( storage == Storage::Ring || storage == Storage::Concurrent ? capacity : 0, 0 )
+  , spill_( storage == Storage::Spill && capacity ? make_optional<SpillFile>( capacity ) : nullopt )
+  , spill_window_( spill_window )
+  , capacity_ { capacity }
+{}
+
+void ByteStream::set_capacity( uint64_t capacity )
+{
+  if ( storage_ == Storage::Concurrent || storage_ == Storage::Spill ) {
+    throw runtime_error( "ByteStream::set_capacity: not supported with Concurrent or Spill storage" );
+  }
+
+  const uint64_t popped = poped_count_.load( memory_order_relaxed );
+  const uint64_t pushed = pushed_count_.load( memory_order_relaxed );
+  capacity = max( capacity, pushed - popped ); // never drop buffered bytes
+  if ( storage_ == Storage::Ring && capacity != capacity_ ) {
+    // Keep the bytes written ahead of the write position too, as far as they still fit.
+    decltype( buffer_ ) resized( capacity, 0 );
+    uint64_t index = popped;
+    const uint64_t kept = min( capacity, capacity_ );
+    for_each_ring_range( capacity_, popped, popped + kept, [&]( uint64_t offset, uint64_t len ) {
+      const char* source = buffer_.data() + offset;
+      for_each_ring_range( capacity, index, index + len, [&]( uint64_t to, uint64_t n ) {
+        copy_n( source, n, resized.data() + to );
+        source += n;
+      } );
+      index += len;
+    } );
+    buffer_ = move( resized );
+  }
+  capacity_ = capacity;
+  notify_edges_();
+}
+
+void ByteStream::set_error()
+{
+  error_.store( true, memory_order_release );
+  notify_();
+}
+
+void ByteStream::notify_()
+{
+  if ( storage_ == Storage::Concurrent ) {
+    events_.fetch_add( 1, memory_order_release );
+    events_.notify_all();
+  } else {
+    notify_edges_();
+  }
+}
+
+void ByteStream::notify_edges_()
+{
+  if ( writable_changed_ && writer().writable() != was_writable_ ) {
+    was_writable_ = !was_writable_;
+    writable_changed_( was_writable_ );
+  }
+  if ( readable_changed_ && reader().readable() != was_readable_ ) {
+    was_readable_ = !was_readable_;
+    readable_changed_( was_readable_ );
+  }
+}
+
+void ByteStream::page_out_()
+{
+  // Keep a window behind the write position (and one ahead of the read position) in memory.
+  const uint64_t pushed = pushed_count_.load( memory_order_relaxed );
+  if ( !spill_ || pushed - paged_out_ < 2 * spill_window_ ) {
+    return;
+  }
+
+  const uint64_t from = max( paged_out_, poped_count_.load( memory_order_acquire ) + spill_window_ );
+  const uint64_t to = pushed - spill_window_;
+  for_each_ring_range( capacity_, from, to, [&]( uint64_t offset, uint64_t len ) {
+    spill_->page_out( offset, len );
+  } );
+  paged_out_ = to - ( to % capacity_ ) % SpillFile::page_size(); // resume at the partly paged-out page
+}
+
+void ByteStream::release_()
+{
+  const uint64_t popped = poped_count_.load( memory_order_relaxed );
+  if ( !spill_ || popped - released_ < spill_window_ ) {
+    return;
+  }
+
+  // Bytes more than a ring behind the write position share their offsets with bytes written since: keep those
+  const uint64_t pushed = pushed_count_.load( memory_order_relaxed );
+  const uint64_t from = max( released_, pushed > capacity_ ? pushed - capacity_ : 0 );
+  for_each_ring_range( capacity_, from, popped, [&]( uint64_t offset, uint64_t len ) {
+    spill_->release( offset, len );
+  } );
+  released_ = popped - ( popped % capacity_ ) % SpillFile::page_size(); // resume at the partly popped page
+}
+
+void ByteStream::wait_( const auto& ready ) const
+{
+  for ( auto seen = events_.load( memory_order_acquire ); !ready(); seen = events_.load( memory_order_acquire ) ) {
+    events_.wait( seen, memory_order_acquire );
+  }
+}
 
 void Writer::push( string data )
 {
-  auto available_capacity = this->available_capacity();
-  auto len = data.size();
-  auto bytes_to_be_pushed = min( available_capacity, len );
+  const uint64_t len = min( available_capacity(), static_cast<uint64_t>( data.size() ) );
+  if ( is_closed() || !len ) {
+    return;
+  }
+
+  const uint64_t pushed = pushed_count_.load( memory_order_relaxed );
+  if ( storage_ == Storage::Chunked ) {
+    data.resize( len );
+    chunks_.push_back( move( data ) );
+  } else {
+    // Copy into the free region, which may wrap around the end of the ring.
+    const uint64_t start = pushed % capacity_;
+    const uint64_t first = min( len, capacity_ - start );
+    copy_n( data.data(), first, ring_() + start );
+    copy_n( data.data() + first, len - first, ring_() );
+  }
+  pushed_count_.store( pushed + len, memory_order_release );
+  notify_();
+  page_out_();
+}
+
+void Writer::write_ahead( uint64_t offset, string_view data )
+{
+  if ( storage_ == Storage::Chunked ) {
+    throw runtime_error( "Writer::write_ahead: not supported with Chunked storage" );
+  }
+  const uint64_t available = available_capacity();
+  if ( offset >= available ) {
+    return;
+  }
+
+  data = data.substr( 0, available - offset );
+  const uint64_t from = pushed_count_.load( memory_order_relaxed ) + offset;
+  const char* source = data.data();
+  for_each_ring_range( capacity_, from, from + data.size(), [&]( uint64_t start, uint64_t len ) {
+    copy_n( source, len, ring_() + start );
+    source += len;
+  } );
+}
+
+void Writer::commit( uint64_t len )
+{
+  len = min( len, available_capacity() );
+  if ( is_closed() || !len ) {
+    return;
+  }
+  pushed_count_.store( pushed_count_.load( memory_order_relaxed ) + len, memory_order_release );
+  notify_();
+  page_out_();
+}
+
+uint64_t Writer::push_from( FileDescriptor& fd )
+{
+  const uint64_t available = available_capacity();
+  if ( is_closed() || !available ) {
+    return 0;
+  }
+
+  if ( storage_ == Storage::Chunked ) {
+    // Read into the reusable read buffer. A read that fills most of it hands the buffer over as the chunk
+    // (push() moves it); a short one is copied into a chunk of its own size, so that the buffer is not
+    // reallocated for every read, and a mostly-empty chunk does not pin a whole buffer's worth of memory.
+    constexpr uint64_t chunk_read_size = 65536;
+    if ( read_buffer_.empty() ) {
+      read_buffer_.resize( chunk_read_size );
+    }
+    const uint64_t len = fd.read( { span { read_buffer_.data(), min( available, chunk_read_size ) } } );
+    if ( 2 * len >= chunk_read_size ) {
+      read_buffer_.resize( len );
+      push( exchange( read_buffer_, {} ) );
+    } else {
+      push( { read_buffer_.data(), len } );
+    }
+    return len;
+  }
 
-  if ( !closed_ && len && available_capacity ) {
-    buffer_.insert( buffer_.end(), data.begin(), std::next( data.begin(), bytes_to_be_pushed ) );
-    pushed_count_ += bytes_to_be_pushed;
+  // Read straight into the free region of the ring, in (at most) two pieces.
+  const uint64_t pushed = pushed_count_.load( memory_order_relaxed );
+  const uint64_t start = pushed % capacity_;
+  const uint64_t first = min( available, capacity_ - start );
+  const uint64_t len = fd.read( { span { ring_() + start, first }, span { ring_(), available - first } } );
+  if ( len ) {
+    pushed_count_.store( pushed + len, memory_order_release );
+    notify_();
+    page_out_();
   }
+  return len;
 }
 
 void Writer::close()
 {
-  closed_ = true;
+  closed_.store( true, memory_order_release );
+  notify_();
+}
+
+void Writer::wait_for_capacity() const
+{
+  wait_( [&] { return writable() || is_closed() || has_error(); } );
+}
+
+void Writer::set_low_watermark( uint64_t low_watermark )
+{
+  low_watermark_ = low_watermark;
+  notify_edges_();
+}
+
+bool Writer::writable() const
+{
+  return !is_closed() && !has_error() && available_capacity() > capacity_ - min( low_watermark_, capacity_ );
+}
+
+void Writer::on_writable_change( function<void( bool )> callback )
+{
+  if ( storage_ == Storage::Concurrent ) {
+    throw runtime_error( "Writer::on_writable_change: not supported with Concurrent storage" );
+  }
+  writable_changed_ = move( callback );
+  was_writable_ = writable();
+  if ( writable_changed_ ) {
+    writable_changed_( was_writable_ );
+  }
 }
 
 bool Writer::is_closed() const
 {
-  return closed_;
+  return closed_.load( memory_order_acquire );
 }
 
 uint64_t Writer::available_capacity() const
 {
-  size_t used = buffer_.size();
-  if ( used >= capacity_ ) {
-    return 0UL;
-  } else {
-    return capacity_ - used;
-  }
+  return capacity_ - ( pushed_count_.load( memory_order_relaxed ) - poped_count_.load( memory_order_acquire ) );
 }
 
 uint64_t Writer::bytes_pushed() const
 {
-  return pushed_count_;
+  return pushed_count_.load( memory_order_relaxed );
 }
 
 string_view Reader::peek() const
 {
-  if ( buffer_.empty() ) {
-    return string_view();
-  } else {
-    return string_view( &buffer_.at( 0 ), 1UL );
+  const uint64_t buffered = bytes_buffered();
+  if ( !buffered ) {
+    return {};
+  }
+  if ( storage_ == Storage::Chunked ) {
+    return string_view { chunks_.front() }.substr( chunk_offset_ );
+  }
+  const uint64_t start = bytes_popped() % capacity_;
+  return { ring_() + start, min( buffered, capacity_ - start ) };
+}
+
+string_view Reader::peek_wrapped() const
+{
+  const uint64_t buffered = bytes_buffered();
+  if ( !buffered ) {
+    return {};
+  }
+  if ( storage_ == Storage::Chunked ) {
+    return chunks_.size() > 1 ? string_view { chunks_[1] } : string_view {};
   }
+  const uint64_t first = capacity_ - bytes_popped() % capacity_;
+  return { ring_(), buffered > first ? buffered - first : 0 };
+}
+
+vector<string_view> Reader::peek_regions( size_t max_regions ) const
+{
+  vector<string_view> regions;
+  if ( !bytes_buffered() || !max_regions ) {
+    return regions;
+  }
+
+  if ( storage_ == Storage::Chunked ) {
+    regions.reserve( min( chunks_.size(), max_regions ) );
+    regions.push_back( peek() );
+    for ( auto it = next( chunks_.begin() ); it != chunks_.end() && regions.size() < max_regions; ++it ) {
+      regions.emplace_back( *it );
+    }
+    return regions;
+  }
+
+  regions.push_back( peek() );
+  if ( const auto wrapped = peek_wrapped(); !wrapped.empty() && max_regions > 1 ) {
+    regions.push_back( wrapped );
+  }
+  return regions;
+}
+
+vector<string_view> Reader::peek_range( uint64_t offset, uint64_t len ) const
+{
+  vector<string_view> regions;
+  const uint64_t buffered = bytes_buffered();
+  len = min( len, buffered > offset ? buffered - offset : 0 );
+  if ( !len ) {
+    return regions;
+  }
+  const uint64_t first = bytes_popped() + offset;
+
+  if ( storage_ == Storage::Chunked ) {
+    // Start from the remembered chunk, unless it was popped or lies past `first`
+    if ( cursor_chunk_ < chunks_popped_ || cursor_index_ > first ) {
+      cursor_chunk_ = chunks_popped_;
+      cursor_index_ = bytes_popped() - chunk_offset_;
+    }
+    while ( cursor_index_ + chunks_[cursor_chunk_ - chunks_popped_].size() <= first ) {
+      cursor_index_ += chunks_[cursor_chunk_ - chunks_popped_].size();
+      cursor_chunk_++;
+    }
+    uint64_t skip = first - cursor_index_;
+    for ( auto it = chunks_.begin() + static_cast<ptrdiff_t>( cursor_chunk_ - chunks_popped_ ); len; ++it ) {
+      const auto region = string_view { *it }.substr( skip, len );
+      regions.push_back( region );
+      len -= region.size();
+      skip = 0;
+    }
+    return regions;
+  }
+
+  for_each_ring_range( capacity_, first, first + len, [&]( uint64_t position, uint64_t n ) {
+    regions.emplace_back( ring_() + position, n );
+  } );
+  return regions;
+}
+
+uint64_t Reader::pop_into( FileDescriptor& fd )
+{
+  if ( !bytes_buffered() ) {
+    return 0;
+  }
+  const uint64_t len = fd.write( peek_regions() );
+  pop( len );
+  return len;
 }
 
 void Reader::pop( uint64_t len )
 {
-  auto bytes_to_be_poped = min( buffer_.size(), len );
-  buffer_.erase( buffer_.begin(), std::next( buffer_.begin(), bytes_to_be_poped ) );
-  poped_count_ += bytes_to_be_poped;
+  len = min( bytes_buffered(), len );
+  if ( !len ) {
+    return;
+  }
+
+  if ( storage_ == Storage::Chunked ) {
+    for ( uint64_t remaining = len; remaining; ) {
+      const uint64_t in_front = chunks_.front().size() - chunk_offset_;
+      if ( remaining < in_front ) {
+        chunk_offset_ += remaining;
+        break;
+      }
+      remaining -= in_front;
+      chunks_.pop_front();
+      chunks_popped_++;
+      chunk_offset_ = 0;
+    }
+  }
+  poped_count_.store( bytes_popped() + len, memory_order_release );
+  notify_();
+  release_();
+}
+
+void Reader::wait_for_data() const
+{
+  wait_( [&] { return readable() || is_finished() || has_error(); } );
+}
+
+void Reader::set_high_watermark( uint64_t high_watermark )
+{
+  high_watermark_ = high_watermark;
+  notify_edges_();
+}
+
+bool Reader::readable() const
+{
+  const uint64_t buffered = bytes_buffered();
+  return buffered && ( buffered >= min( high_watermark_, capacity_ ) || closed_.load( memory_order_acquire ) );
+}
+
+void Reader::on_readable_change( function<void( bool )> callback )
+{
+  if ( storage_ == Storage::Concurrent ) {
+    throw runtime_error( "Reader::on_readable_change: not supported with Concurrent storage" );
+  }
+  readable_changed_ = move( callback );
+  was_readable_ = readable();
+  if ( readable_changed_ ) {
+    readable_changed_( was_readable_ );
+  }
 }
 
 bool Reader::is_finished() const
 {
-  return closed_ && buffer_.empty();
+  return closed_.load( memory_order_acquire ) && !bytes_buffered();
 }
 
 uint64_t Reader::bytes_buffered() const
 {
-  return buffer_.size();
+  return pushed_count_.load( memory_order_acquire ) - poped_count_.load( memory_order_relaxed );
 }
 
 uint64_t Reader::bytes_popped() const
 {
-  return poped_count_;
+  return poped_count_.load( memory_order_relaxed );
 }
@@ -1,17 +1,57 @@
 #pragma once
 
+#include "buffer_pool.hh"
+#include "spill_file.hh"
+
+#include <atomic>
+#include <climits>
 #include <cstdint>
 #include <deque>
+#include <functional>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 
 class Reader;
 class Writer;
 
+// A std::atomic that can still be copied (non-atomically) along with the ByteStream that holds it.
+template<typename T>
+class CopyableAtomic : public std::atomic<T>
+{
+public:
+  CopyableAtomic( T value ) : std::atomic<T>( value ) {} // NOLINT(*-explicit-*)
+  CopyableAtomic( const CopyableAtomic& other ) : std::atomic<T>( other.load() ) {}
+  CopyableAtomic& operator=( const CopyableAtomic& other )
+  {
+    this->store( other.load() );
+    return *this;
+  }
+  ~CopyableAtomic() = default;
+};
+
 class ByteStream
 {
 public:
-  explicit ByteStream( uint64_t capacity );
+  // How the stream keeps buffered bytes.
+  enum class Storage
+  {
+    Ring,    // Copy pushed bytes into a preallocated ring of `capacity` bytes.
+    Chunked, // Keep pushed strings as owned chunks; push() is a move and peek() returns the front chunk.
+    // Ring storage that one Writer thread and one Reader thread may use at the same time (lock-free),
+    // with Writer::wait_for_capacity() and Reader::wait_for_data() to block until the other side acts.
+    Concurrent,
+    // Ring storage in a memory-mapped temporary file, for capacities larger than should stay in RAM. Only the
+    // `spill_window` bytes around the read and write positions are kept resident; the middle goes to disk.
+    Spill,
+  };
+
+  static constexpr uint64_t DEFAULT_SPILL_WINDOW = 1 << 20;
+
+  explicit ByteStream( uint64_t capacity,
+                       Storage storage = Storage::Ring,
+                       uint64_t spill_window = DEFAULT_SPILL_WINDOW );
 
   // Helper functions (provided) to access the ByteStream's Reader and Writer interfaces
   Reader& reader();
@@ -19,18 +59,67 @@ public:
   Writer& writer();
   const Writer& writer() const;
 
-  void set_error() { error_ = true; };       // Signal that the stream suffered an error.
+  // Grow or shrink the capacity (never below the bytes currently buffered). Ring and Chunked storage only.
+  // Bytes written ahead (see Writer::write_ahead) are kept as far as they fit in the new capacity.
+  void set_capacity( uint64_t capacity );
+  Storage storage() const { return storage_; }
+
+  void set_error();                         // Signal that the stream suffered an error.
   bool has_error() const { return error_; }; // Has the stream had an error?
 
 protected:
   // Please add any additional state to the ByteStream here, and not to the Writer and Reader interfaces.
-  bool closed_ = false;
-  uint64_t poped_count_ = 0;
-  uint64_t pushed_count_ = 0;
+  // The counters are atomic so that a Concurrent stream's Writer and Reader can each advance their own one
+  // (release) and observe the other's (acquire). They are only ever loaded and stored, never read-modify-written.
+  CopyableAtomic<bool> closed_ = false;
+  CopyableAtomic<uint64_t> poped_count_ = 0;
+  CopyableAtomic<uint64_t> pushed_count_ = 0;
+
+  Storage storage_;
+
+  // Ring storage: byte `i` of the stream lives at ring_()[i % capacity_], in buffer_ or in spill_.
+  std::vector<char, PoolAllocator<char>> buffer_;
+  char* ring_() { return spill_ ? spill_->data() : buffer_.data(); }
+  const char* ring_() const { return spill_ ? spill_->data() : buffer_.data(); }
+
+  // Spill storage: the stream indices up to which the middle of the stream was paged out to disk,
+  // and up to which popped bytes were released from the file.
+  std::optional<SpillFile> spill_ {};
+  uint64_t spill_window_;
+  uint64_t paged_out_ = 0;
+  uint64_t released_ = 0;
+  void page_out_();
+  void release_();
+
+  // Chunked storage: owned chunks in stream order, the first one partially popped by chunk_offset_ bytes.
+  std::deque<std::string, PoolAllocator<std::string>> chunks_ {};
+  uint64_t chunk_offset_ = 0;
+  uint64_t chunks_popped_ = 0;
+  std::string read_buffer_ {}; // for push_from(), kept between reads unless handed over as a chunk
+
+  // The chunk where peek_range() last started (counting popped chunks), and the stream index of its first byte
+  mutable uint64_t cursor_chunk_ = 0;
+  mutable uint64_t cursor_index_ = 0;
 
-  std::deque<char> buffer_;
   uint64_t capacity_;
-  bool error_ {};
+  CopyableAtomic<bool> error_ = false;
+
+  // Readiness thresholds: the Writer is writable while fewer than low_watermark_ bytes are buffered
+  // (by default, while there is any capacity), and the Reader is readable once high_watermark_ bytes are.
+  uint64_t low_watermark_ = UINT64_MAX;
+  uint64_t high_watermark_ = 1;
+
+  // Edge notifications (see Writer::on_writable_change): the callbacks, and the state they were last told of
+  std::function<void( bool )> writable_changed_ {};
+  std::function<void( bool )> readable_changed_ {};
+  bool was_writable_ = false;
+  bool was_readable_ = false;
+  void notify_edges_();
+
+  // Concurrent storage: bumped on every push, pop, close or error so that waiters wake up.
+  CopyableAtomic<uint32_t> events_ = 0;
+  void notify_();
+  void wait_( const auto& ready ) const;
 };
 
 class Writer : public ByteStream
@@ -39,6 +128,27 @@ public:
   void push( std::string data ); // Push data to stream, but only as much as available capacity allows.
   void close();                  // Signal that the stream has reached its ending. Nothing more will be written.
 
+  // Ring-based storage: copy `data` into the free space `offset` bytes past the write position without pushing
+  // it (bytes beyond the available capacity are dropped), so that commit() can later push it without a copy.
+  void write_ahead( uint64_t offset, std::string_view data );
+  void commit( uint64_t len ); // Push the next `len` bytes of free space, as written by write_ahead()
+
+  // Read from `fd` directly into the stream's free space (as much as capacity allows); returns bytes read.
+  uint64_t push_from( FileDescriptor& fd );
+
+  // Concurrent storage: block until writable(), or the stream was closed or had an error
+  void wait_for_capacity() const;
+
+  // Only report writable() once the buffer has drained below `low_watermark` bytes (capped to the capacity),
+  // so that a producer wakes up to write a large batch rather than a trickle.
+  void set_low_watermark( uint64_t low_watermark );
+  bool writable() const; // Open, no error, and fewer than the low watermark's bytes buffered?
+
+  // Call `callback( writable() )` now, then whenever a push, pop, close, error or setting flips writable(), so
+  // that an event loop can keep its interest in a flag instead of re-checking the watermark every iteration.
+  // Not with Concurrent storage (see wait_for_capacity).
+  void on_writable_change( std::function<void( bool )> callback );
+
   bool is_closed() const;              // Has the stream been closed?
   uint64_t available_capacity() const; // How many bytes can be pushed to the stream right now?
   uint64_t bytes_pushed() const;       // Total number of bytes cumulatively pushed to the stream
@@ -47,8 +157,28 @@ public:
 class Reader : public ByteStream
 {
 public:
-  std::string_view peek() const; // Peek at the next bytes in the buffer
-  void pop( uint64_t len );      // Remove `len` bytes from the buffer
+  std::string_view peek() const;         // Peek at the next bytes in the buffer (largest contiguous span)
+  std::string_view peek_wrapped() const; // Peek at the buffered bytes that follow peek() (empty unless wrapped)
+  void pop( uint64_t len );              // Remove `len` bytes from the buffer
+  void wait_for_data() const;            // Concurrent storage: block until readable(), or finished/error
+
+  // Only report readable() once `high_watermark` bytes are buffered (capped to the capacity), or the stream
+  // is closed with bytes still buffered, so that a consumer wakes up to read a large batch.
+  void set_high_watermark( uint64_t high_watermark );
+  bool readable() const; // At least the high watermark's bytes buffered (or any, if closed)?
+
+  // Call `callback( readable() )` now, then whenever readable() flips (see Writer::on_writable_change)
+  void on_readable_change( std::function<void( bool )> callback );
+
+  // Peek at every buffered region in stream order (at most `max_regions`, so the result fits one writev)
+  std::vector<std::string_view> peek_regions( size_t max_regions = IOV_MAX ) const;
+
+  // Peek at the regions holding (up to) `len` buffered bytes, starting `offset` bytes past the read position.
+  // Reading a Chunked stream front to back costs O(1) per chunk: the chunk last found is remembered.
+  std::vector<std::string_view> peek_range( uint64_t offset, uint64_t len ) const;
+
+  // Write buffered bytes directly from the stream to `fd` and pop what was written; returns bytes written.
+  uint64_t pop_into( FileDescriptor& fd );
 
   bool is_finished() const;        // Is the stream finished (closed and fully popped)?
   uint64_t bytes_buffered() const; // Number of bytes currently buffered (pushed and not popped)
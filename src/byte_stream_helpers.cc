@@ -1,5 +1,6 @@
 #include "byte_stream.hh"
 
+#include <algorithm>
 #include <cstdint>
 #include <stdexcept>
 
@@ -12,6 +13,7 @@ using namespace std;
 void read( Reader& reader, uint64_t max_len, string& out )
 {
   out.clear();
+  out.reserve( min( max_len, reader.bytes_buffered() ) );
 
   while ( reader.bytes_buffered() and out.size() < max_len ) {
     auto view = reader.peek();
@@ -0,0 +1,273 @@
+#include "congestion_control.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+string_view CongestionControl::name( Algorithm algorithm )
+{
+  switch ( algorithm ) {
+    case Algorithm::None:
+      return "none";
+    case Algorithm::NewReno:
+      return "newreno";
+    case Algorithm::Cubic:
+      return "cubic";
+    case Algorithm::BBR:
+      return "bbr";
+  }
+  throw invalid_argument( "CongestionControl::name: unknown algorithm" );
+}
+
+unique_ptr<CongestionControl> CongestionControl::make( Algorithm algorithm, uint64_t mss )
+{
+  switch ( algorithm ) {
+    case Algorithm::None:
+      return nullptr;
+    case Algorithm::NewReno:
+      return make_unique<NewReno>( mss );
+    case Algorithm::Cubic:
+      return make_unique<Cubic>( mss );
+    case Algorithm::BBR:
+      return make_unique<BBR>( mss );
+  }
+  throw invalid_argument( "CongestionControl::make: unknown algorithm" );
+}
+
+void NewReno::on_ack( uint64_t now [[maybe_unused]],
+                      uint64_t acked,
+                      uint64_t in_flight [[maybe_unused]],
+                      optional<uint64_t> rtt [[maybe_unused]] )
+{
+  // During fast recovery, (partial) ACKs only deflate what is in flight; the window itself holds.
+  if ( in_recovery_ ) {
+    return;
+  }
+
+  // Slow start: grow by what was acknowledged, up to the threshold.
+  if ( cwnd_ < ssthresh_ ) {
+    const uint64_t growth = min( acked, ssthresh_ - cwnd_ );
+    cwnd_ += growth;
+    acked -= growth;
+  }
+
+  // Congestion avoidance: one segment per window's worth of acknowledged data.
+  bytes_acked_ += acked;
+  if ( bytes_acked_ >= cwnd_ ) {
+    bytes_acked_ -= cwnd_;
+    cwnd_ += mss_;
+  }
+}
+
+void NewReno::on_loss( uint64_t now [[maybe_unused]], uint64_t in_flight )
+{
+  ssthresh_ = max( in_flight / 2, 2 * mss_ );
+  cwnd_ = ssthresh_;
+  bytes_acked_ = 0;
+  in_recovery_ = true;
+}
+
+void NewReno::on_rto( uint64_t now [[maybe_unused]], uint64_t in_flight )
+{
+  ssthresh_ = max( in_flight / 2, 2 * mss_ );
+  cwnd_ = mss_;
+  bytes_acked_ = 0;
+  in_recovery_ = false;
+}
+
+void NewReno::on_recovered( uint64_t now [[maybe_unused]] )
+{
+  in_recovery_ = false;
+}
+
+void NewReno::set_mss( uint64_t mss )
+{
+  cwnd_ = rescale_( cwnd_, mss );
+  if ( ssthresh_ != UINT64_MAX ) {
+    ssthresh_ = rescale_( ssthresh_, mss );
+  }
+  bytes_acked_ = rescale_( bytes_acked_, mss );
+  CongestionControl::set_mss( mss );
+}
+
+void Cubic::on_send( uint64_t now, uint64_t length [[maybe_unused]], uint64_t in_flight )
+{
+  // After an idle period, resume the cubic curve where it left off rather than jumping ahead (RFC 9438 5.8).
+  if ( !in_flight && idle_since_ ) {
+    if ( epoch_ ) {
+      *epoch_ += now - *idle_since_;
+    }
+    idle_since_.reset();
+  }
+}
+
+void Cubic::on_ack( uint64_t now, uint64_t acked, uint64_t in_flight, optional<uint64_t> rtt )
+{
+  if ( rtt ) {
+    srtt_ = srtt_ ? ( 7 * srtt_ + *rtt ) / 8 : *rtt;
+  }
+  if ( !in_flight ) {
+    idle_since_ = now;
+  }
+
+  if ( cwnd_ < ssthresh_ ) {
+    cwnd_ = min( cwnd_ + static_cast<double>( acked ), ssthresh_ );
+    return;
+  }
+
+  const double cwnd = segments_();
+  if ( !epoch_ ) {
+    epoch_ = now;
+    w_est_ = cwnd;
+    if ( cwnd < w_max_ ) {
+      k_ = cbrt( ( w_max_ - cwnd ) / C );
+    } else {
+      k_ = 0;
+      w_max_ = cwnd;
+    }
+  }
+
+  // Where the cubic curve will be one RTT from now, limited to 1.5x growth per RTT.
+  const double t = static_cast<double>( now - *epoch_ + srtt_ ) / 1000;
+  double target = clamp( C * pow( t - k_, 3 ) + w_max_, cwnd, 1.5 * cwnd );
+
+  // Reno-friendly region: never grow more slowly than standard TCP would.
+  const double segments_acked = static_cast<double>( acked ) / static_cast<double>( mss_ );
+  w_est_ += 3 * ( 1 - BETA ) / ( 1 + BETA ) * segments_acked / cwnd;
+  target = max( target, w_est_ );
+
+  cwnd_ += ( target - cwnd ) / cwnd * static_cast<double>( acked );
+}
+
+void Cubic::reduce_( uint64_t in_flight )
+{
+  // Reduce from what was actually in flight: the window may have grown past it while the receiver's was smaller.
+  epoch_.reset();
+  const double flight = min( cwnd_, static_cast<double>( in_flight ) );
+  const double cwnd = flight / static_cast<double>( mss_ );
+  w_max_ = cwnd < w_max_ ? cwnd * ( 1 + BETA ) / 2 : cwnd; // fast convergence: yield to newer flows
+  ssthresh_ = max( flight * BETA, static_cast<double>( 2 * mss_ ) );
+}
+
+void Cubic::on_loss( uint64_t now [[maybe_unused]], uint64_t in_flight )
+{
+  reduce_( in_flight );
+  cwnd_ = ssthresh_;
+}
+
+void Cubic::on_rto( uint64_t now [[maybe_unused]], uint64_t in_flight )
+{
+  reduce_( in_flight );
+  cwnd_ = static_cast<double>( mss_ );
+}
+
+void Cubic::set_mss( uint64_t mss )
+{
+  // w_max_ and w_est_ are already in segments
+  const double scale = static_cast<double>( mss ) / static_cast<double>( mss_ );
+  cwnd_ *= scale;
+  ssthresh_ *= scale;
+  CongestionControl::set_mss( mss );
+}
+
+uint64_t BBR::bottleneck_bandwidth() const
+{
+  return bw_samples_.empty() ? 0 : *ranges::max_element( bw_samples_ );
+}
+
+uint64_t BBR::bdp_( double gain ) const
+{
+  const auto bdp = static_cast<double>( bottleneck_bandwidth() * min_rtt_.value_or( 0 ) ) / 1000;
+  return max( static_cast<uint64_t>( gain * bdp ), 4 * mss_ );
+}
+
+optional<uint64_t> BBR::pacing_rate() const
+{
+  // The bottleneck bandwidth, or (during startup) enough more to double the delivery rate each round
+  const uint64_t bw = bottleneck_bandwidth();
+  return bw ? optional { static_cast<uint64_t>( ( filled_pipe_ ? 1.0 : STARTUP_GAIN ) * bw ) } : nullopt;
+}
+
+uint64_t BBR::window() const
+{
+  uint64_t cwnd = startup_cwnd_;
+  if ( filled_pipe_ ) {
+    cwnd = bdp_( CWND_GAIN );
+  } else if ( bottleneck_bandwidth() ) {
+    cwnd = min( cwnd, max( bdp_( STARTUP_GAIN ), INITIAL_WINDOW_SEGMENTS * mss_ ) );
+  }
+  return recovery_cwnd_ ? min( cwnd, *recovery_cwnd_ ) : cwnd;
+}
+
+void BBR::on_ack( uint64_t now, uint64_t acked, uint64_t in_flight [[maybe_unused]], optional<uint64_t> rtt )
+{
+  if ( rtt && ( !min_rtt_ || *rtt <= *min_rtt_ || now - min_rtt_stamp_ > MIN_RTT_WINDOW_MS ) ) {
+    min_rtt_ = max<uint64_t>( *rtt, 1 );
+    min_rtt_stamp_ = now;
+  }
+
+  round_delivered_ += acked;
+  if ( !filled_pipe_ ) {
+    startup_cwnd_ += acked;
+  }
+  if ( recovery_cwnd_ ) {
+    *recovery_cwnd_ += acked;
+  }
+  if ( min_rtt_ && now - round_start_ >= *min_rtt_ ) {
+    end_round_( now );
+  }
+}
+
+void BBR::end_round_( uint64_t now )
+{
+  // One delivery-rate sample per round trip, kept in a windowed max filter.
+  const uint64_t bw = round_delivered_ * 1000 / max<uint64_t>( now - round_start_, 1 );
+  round_start_ = now;
+  round_delivered_ = 0;
+  recovery_cwnd_.reset();
+  if ( unsampled_rounds_ ) {
+    unsampled_rounds_--;
+    return;
+  }
+  bw_samples_.push_back( bw );
+  if ( bw_samples_.size() > BANDWIDTH_FILTER_ROUNDS ) {
+    bw_samples_.pop_front();
+  }
+
+  // The pipe is full once three rounds in a row fail to raise the bandwidth by a quarter.
+  if ( !filled_pipe_ ) {
+    if ( bw >= full_bw_ + full_bw_ / 4 ) {
+      full_bw_ = bw;
+      full_bw_rounds_ = 0;
+    } else if ( ++full_bw_rounds_ >= 3 ) {
+      filled_pipe_ = true;
+    }
+  }
+}
+
+void BBR::on_loss( uint64_t now [[maybe_unused]], uint64_t in_flight )
+{
+  // Packet conservation: send one new segment per segment that leaves the network, for a round.
+  recovery_cwnd_ = max( in_flight, mss_ );
+  unsampled_rounds_ = 2;
+}
+
+void BBR::on_rto( uint64_t now, uint64_t in_flight [[maybe_unused]] )
+{
+  recovery_cwnd_ = mss_;
+  unsampled_rounds_ = 2;
+  round_start_ = now;
+  round_delivered_ = 0;
+}
+
+void BBR::set_mss( uint64_t mss )
+{
+  // The model itself is in bytes and time; only the windows counted from the segment size change
+  startup_cwnd_ = rescale_( startup_cwnd_, mss );
+  if ( recovery_cwnd_ ) {
+    recovery_cwnd_ = rescale_( *recovery_cwnd_, mss );
+  }
+  CongestionControl::set_mss( mss );
+}
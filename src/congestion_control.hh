@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+// A congestion controller limits how many sequence numbers the TCPSender keeps in flight, on top of the
+// limit set by the peer's receive window. The sender reports its events; the controller adjusts the window.
+// All times are in milliseconds on the sender's clock (the sum of the ticks it has seen).
+class CongestionControl
+{
+public:
+  enum class Algorithm
+  {
+    None,    // no congestion window: only the receive window limits the sender
+    NewReno, // RFC 5681/6582 slow start and AIMD
+    Cubic,   // RFC 9438 cubic window growth
+    BBR,     // simplified BBR: window = gain * estimated bottleneck bandwidth * min RTT
+  };
+
+  static std::string_view name( Algorithm algorithm );
+
+  // Construct the controller for `algorithm` (nullptr for None), for segments of up to `mss` bytes
+  static std::unique_ptr<CongestionControl> make( Algorithm algorithm, uint64_t mss );
+
+  explicit CongestionControl( uint64_t mss ) : mss_( mss ) {}
+  virtual ~CongestionControl() = default;
+  CongestionControl( const CongestionControl& other ) = delete;
+  CongestionControl& operator=( const CongestionControl& other ) = delete;
+
+  // The congestion window, in sequence numbers
+  virtual uint64_t window() const = 0;
+
+  // A segment of `length` sequence numbers was sent for the first time, with `in_flight` outstanding before it
+  virtual void on_send( uint64_t now [[maybe_unused]],
+                        uint64_t length [[maybe_unused]],
+                        uint64_t in_flight [[maybe_unused]] )
+  {}
+
+  // `acked` more sequence numbers reached the peer (cumulatively or by SACK), leaving `in_flight` outstanding.
+  // `rtt` is a round-trip sample from a segment that was not retransmitted (Karn's algorithm), if there is one.
+  virtual void on_ack( uint64_t now, uint64_t acked, uint64_t in_flight, std::optional<uint64_t> rtt ) = 0;
+
+  // A loss was detected while the connection is still flowing (e.g., by duplicate ACKs)
+  virtual void on_loss( uint64_t now, uint64_t in_flight ) = 0;
+
+  // Everything outstanding when the loss was detected has been acknowledged: fast recovery is over
+  virtual void on_recovered( uint64_t now [[maybe_unused]] ) {}
+
+  // The retransmission timer expired
+  virtual void on_rto( uint64_t now, uint64_t in_flight ) = 0;
+
+  // The rate (in bytes per second) to pace segments at, if the controller models one. Otherwise a pacing
+  // sender spreads the window over a round trip.
+  virtual std::optional<uint64_t> pacing_rate() const { return std::nullopt; }
+
+  // The segment size changed (e.g., once the peer's MSS is known): the windows keep their size in segments
+  virtual void set_mss( uint64_t mss ) { mss_ = mss; }
+
+protected:
+  uint64_t mss_;
+
+  // `bytes`, counted in segments of `mss` rather than of mss_
+  uint64_t rescale_( uint64_t bytes, uint64_t mss ) const
+  {
+    return bytes / mss_ * mss + bytes % mss_ * mss / mss_;
+  }
+
+  static constexpr uint64_t INITIAL_WINDOW_SEGMENTS = 10; // RFC 6928
+};
+
+class NewReno : public CongestionControl
+{
+public:
+  explicit NewReno( uint64_t mss ) : CongestionControl( mss ) {}
+
+  uint64_t window() const override { return cwnd_; }
+  uint64_t slow_start_threshold() const { return ssthresh_; }
+
+  void on_ack( uint64_t now, uint64_t acked, uint64_t in_flight, std::optional<uint64_t> rtt ) override;
+  void on_loss( uint64_t now, uint64_t in_flight ) override;
+  void on_rto( uint64_t now, uint64_t in_flight ) override;
+  void on_recovered( uint64_t now ) override;
+  void set_mss( uint64_t mss ) override;
+
+private:
+  uint64_t cwnd_ { INITIAL_WINDOW_SEGMENTS * mss_ };
+  uint64_t ssthresh_ { UINT64_MAX };
+  uint64_t bytes_acked_ {}; // acknowledged during congestion avoidance, not yet turned into window growth
+  bool in_recovery_ {};     // the window holds at ssthresh until fast recovery ends (RFC 6582)
+};
+
+class Cubic : public CongestionControl
+{
+public:
+  explicit Cubic( uint64_t mss ) : CongestionControl( mss ) {}
+
+  uint64_t window() const override { return static_cast<uint64_t>( cwnd_ ); }
+
+  void on_send( uint64_t now, uint64_t length, uint64_t in_flight ) override;
+  void on_ack( uint64_t now, uint64_t acked, uint64_t in_flight, std::optional<uint64_t> rtt ) override;
+  void on_loss( uint64_t now, uint64_t in_flight ) override;
+  void on_rto( uint64_t now, uint64_t in_flight ) override;
+  void set_mss( uint64_t mss ) override;
+
+  static constexpr double C = 0.4;    // scaling constant, in segments / s^3
+  static constexpr double BETA = 0.7; // multiplicative decrease factor
+
+private:
+  void reduce_( uint64_t in_flight );
+  double segments_() const { return cwnd_ / static_cast<double>( mss_ ); }
+
+  double cwnd_ = static_cast<double>( INITIAL_WINDOW_SEGMENTS * mss_ ); // bytes, kept fractional while growing
+  double ssthresh_ = static_cast<double>( UINT64_MAX );
+  double w_max_ {};                       // window (in segments) before the last reduction
+  double k_ {};                           // time (in s) the cubic function takes to grow back to w_max_
+  double w_est_ {};                       // Reno-friendly window estimate, in segments
+  std::optional<uint64_t> epoch_ {};      // start of the current congestion-avoidance epoch
+  std::optional<uint64_t> idle_since_ {}; // when the sender last ran out of data in flight
+  uint64_t srtt_ {};
+};
+
+class BBR : public CongestionControl
+{
+public:
+  explicit BBR( uint64_t mss ) : CongestionControl( mss ) {}
+
+  uint64_t window() const override;
+  uint64_t bottleneck_bandwidth() const; // in bytes per second
+  std::optional<uint64_t> min_rtt() const { return min_rtt_; }
+
+  void on_ack( uint64_t now, uint64_t acked, uint64_t in_flight, std::optional<uint64_t> rtt ) override;
+  void on_loss( uint64_t now, uint64_t in_flight ) override;
+  void on_rto( uint64_t now, uint64_t in_flight ) override;
+  std::optional<uint64_t> pacing_rate() const override;
+  void set_mss( uint64_t mss ) override;
+
+  static constexpr uint64_t BANDWIDTH_FILTER_ROUNDS = 10; // max-filter length for the bandwidth estimate
+  static constexpr uint64_t MIN_RTT_WINDOW_MS = 10000;    // how long an RTT sample stays the minimum
+  static constexpr double CWND_GAIN = 2.0;
+  static constexpr double STARTUP_GAIN = 2.89; // 2/ln(2): enough to double the delivery rate each round
+
+private:
+  void end_round_( uint64_t now );
+  uint64_t bdp_( double gain ) const;
+
+  bool filled_pipe_ {};                         // startup is over: bandwidth stopped growing
+  uint64_t full_bw_ {};                         // best bandwidth seen while checking for a full pipe
+  uint64_t full_bw_rounds_ {};                  // rounds without 25% bandwidth growth
+  std::deque<uint64_t> bw_samples_ {};          // bytes/s, one per round
+  std::optional<uint64_t> min_rtt_ {};          // ms
+  uint64_t min_rtt_stamp_ {};                   // when min_rtt_ was measured
+  uint64_t round_start_ {};                     // when the current round began
+  uint64_t round_delivered_ {};                 // bytes acknowledged in the current round
+  std::optional<uint64_t> recovery_cwnd_ {};    // after a loss, packet conservation until the round ends
+  uint64_t unsampled_rounds_ {}; // after a loss, ACKs come in bursts that overstate the delivery rate
+
+  // Slow-start window, used until the pipe is full
+  uint64_t startup_cwnd_ { INITIAL_WINDOW_SEGMENTS * mss_ };
+};
@@ -1,9 +1,90 @@
 #include "reassembler.hh"
 #include "debug.hh"
 #include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <utility>
 
 using namespace std;
 
+void PresenceBitmap::reserve( uint64_t bits, uint64_t from, uint64_t to )
+{
+  if ( bits <= size() ) {
+    return;
+  }
+  PresenceBitmap grown;
+  grown.words_.resize( bit_ceil( max<uint64_t>( bits, 64 ) ) / 64 );
+  for ( uint64_t i = from; i < to && size(); i++ ) {
+    if ( test( i ) ) {
+      grown.set( i, i + 1 );
+    }
+  }
+  *this = move( grown );
+}
+
+void PresenceBitmap::update_( uint64_t from, uint64_t to, bool value )
+{
+  // size() is a power of two (and a multiple of 64), so no word straddles the end of the ring.
+  while ( from < to ) {
+    const uint64_t pos = from & ( size() - 1 );
+    const uint64_t bit = pos % 64;
+    const uint64_t len = min( to - from, 64 - bit );
+    const uint64_t mask = ( len == 64 ? ~0ULL : ( 1ULL << len ) - 1 ) << bit;
+    auto& word = words_[pos / 64];
+    count_ -= popcount( word );
+    if ( value ) {
+      word |= mask;
+    } else {
+      word &= ~mask;
+    }
+    count_ += popcount( word );
+    from += len;
+  }
+}
+
+bool PresenceBitmap::test( uint64_t index ) const
+{
+  const uint64_t pos = index & ( size() - 1 );
+  return ( words_[pos / 64] >> ( pos % 64 ) ) & 1;
+}
+
+uint64_t PresenceBitmap::run_length( uint64_t from, uint64_t to ) const
+{
+  uint64_t run = 0;
+  while ( from + run < to ) {
+    const uint64_t pos = ( from + run ) & ( size() - 1 );
+    const uint64_t bit = pos % 64;
+    const uint64_t missing = ~words_[pos / 64] >> bit;
+    if ( missing ) {
+      run += countr_zero( missing );
+      break;
+    }
+    run += 64 - bit;
+  }
+  return min( run, to - from );
+}
+
+uint64_t PresenceBitmap::next_set( uint64_t from, uint64_t to ) const
+{
+  while ( from < to ) {
+    const uint64_t pos = from & ( size() - 1 );
+    const uint64_t bit = pos % 64;
+    const uint64_t present = words_[pos / 64] >> bit;
+    if ( present ) {
+      return min( to, from + countr_zero( present ) );
+    }
+    from += 64 - bit;
+  }
+  return to;
+}
+
+Reassembler::Reassembler( ByteStream&& output, Engine engine ) : output_( std::move( output ) ), engine_( engine )
+{
+  if ( engine_ == Engine::Ring && output_.storage() == ByteStream::Storage::Chunked ) {
+    throw runtime_error( "Reassembler: the Ring engine needs ring-based output storage" );
+  }
+}
+
 void Reassembler::insert( uint64_t first_index, string data, bool is_last_substring )
 {
   auto& writer = output_.writer();
@@ -26,83 +107,213 @@ void Reassembler::insert( uint64_t first_index, string data, bool is_last_substr
   }
 
   // truncate given data to [pushed,unacceptable)
-  if ( d_begin_i < pushed_i ) {
-    data = data.substr( pushed_i - d_begin_i );
-    d_begin_i = pushed_i;
+  d_begin_i = max( d_begin_i, pushed_i );
+  d_end_i = min( d_end_i, unacceptable_i );
+
+  if ( d_begin_i == pushed_i && d_begin_i < d_end_i && ( engine_ == Engine::Ring || cache_.empty() ) ) {
+    // in-order fast path: straight to the output, without going through the pending store
+    stats_.fast_path_inserts++;
+    if ( present_.size() ) {
+      present_.clear( d_begin_i, d_end_i ); // overwritten anyway
+    }
+    if ( output_.storage() == ByteStream::Storage::Chunked ) {
+      data.resize( d_end_i - first_index );
+      data.erase( 0, d_begin_i - first_index );
+      output_.writer().push( move( data ) );
+    } else {
+      push_( string_view { data }.substr( d_begin_i - first_index, d_end_i - d_begin_i ) );
+    }
+  } else if ( d_begin_i < d_end_i ) {
+    stats_.slow_path_inserts++;
+    if ( engine_ == Engine::Ring ) {
+      write_ahead_( d_begin_i, string_view { data }.substr( d_begin_i - first_index, d_end_i - d_begin_i ) );
+    } else {
+      // take ownership of the buffer; trimming is just an offset and length
+      cache_segment_( d_begin_i,
+                      PayloadSlice { allocate_shared<string>( PoolAllocator<string> {}, move( data ) ),
+                                     d_begin_i - first_index,
+                                     d_end_i - d_begin_i } );
+    }
+  }
+
+  flush_();
+
+  if ( !cache_.empty() ) {
+    enforce_limits_(); // after flushing, so that data which just became in-order is never evicted
+    stats_.peak_segments = max<uint64_t>( stats_.peak_segments, cache_.size() );
   }
-  data = data.substr( 0UL, unacceptable_i > d_begin_i ? unacceptable_i - d_begin_i : 0UL );
+}
 
-  // iterater over cached data
-  for (
-    // TODO: Refactor with std::move
-    auto it = cache_.begin(), next = std::next( it ); it != cache_.end() && it->index <= d_end_i;
-    it = next, next = std::next( it ) ) {
-    auto c_begin_i = it->index;                 // current_begin_index
-    auto c_end_i = it->index + it->data.size(); // current_end_index
+void Reassembler::cache_segment_( uint64_t first_index, const PayloadSlice& slice )
+{
+  auto d_end_i = first_index + slice.length; // data_end_index
 
-    if ( c_end_i < d_begin_i ) {
+  // walk the cached slices from the last one starting at or before first_index, filling the gaps between them
+  auto it = cache_.upper_bound( first_index );
+  if ( it != cache_.begin() ) {
+    --it;
+  }
+  bool shared = false;
+  for ( auto pos = first_index; pos < d_end_i; ) {
+    if ( it != cache_.end() && it->first <= pos ) {
+      pos = max( pos, it->first + it->second.length ); // already cached up to here
+      ++it;
       continue;
     }
-
-    if ( c_begin_i <= d_begin_i && c_end_i >= d_end_i ) {
-      return; // ignore already cached data
+    const auto gap_end = it == cache_.end() ? d_end_i : min( d_end_i, it->first );
+    PayloadSlice gap { slice.buffer, slice.offset + pos - first_index, gap_end - pos };
+    if ( 2 * gap.length < gap.buffer->size() ) {
+      gap = { allocate_shared<string>( PoolAllocator<string> {}, gap.view() ), 0, gap.length };
+      buffer_bytes_ += gap.length;
+    } else {
+      shared = true;
     }
+    cache_.emplace_hint( it, pos, move( gap ) );
+    stats_.fragments++;
+    pos = gap_end;
+  }
+  if ( shared ) {
+    buffer_bytes_ += slice.buffer->size();
+  }
+}
 
-    // handle partly overlapping data
-    if ( c_begin_i < d_begin_i && c_end_i <= d_end_i ) {
-      data = it->data.substr( 0UL, d_begin_i - c_begin_i ) + data;
-      d_begin_i = c_begin_i;
-    } else if ( c_begin_i >= d_begin_i && c_end_i > d_end_i ) {
-      data = data + it->data.substr( d_end_i - c_begin_i );
-    }
+void Reassembler::release_( const PayloadSlice& slice )
+{
+  if ( slice.buffer.use_count() == 1 ) {
+    buffer_bytes_ -= slice.buffer->size();
+  }
+}
 
-    // overwrite(delete) overlapping data
-    cache_.erase( it );
+void Reassembler::set_limits( const Limits& limits )
+{
+  limits_ = limits;
+  enforce_limits_();
+}
+
+void Reassembler::enforce_limits_()
+{
+  while ( cache_.size() > limits_.max_segments || memory_pending() > limits_.max_memory_bytes ) {
+    const auto farthest = prev( cache_.end() );
+    stats_.evicted_segments++;
+    stats_.evicted_bytes += farthest->second.length;
+    release_( farthest->second );
+    cache_.erase( farthest );
   }
+}
+
+void Reassembler::write_ahead_( uint64_t first_index, string_view data )
+{
+  auto& writer = output_.writer();
+  const auto pushed_i = writer.bytes_pushed();
+  const auto window_end_i = pushed_i + writer.available_capacity();
 
-  // cache new data
-  auto i_pos = std::lower_bound( cache_.begin(), cache_.end(), d_begin_i );
-  cache_.emplace( i_pos, data, d_begin_i );
+  // If the capacity shrank, the bytes written ahead past the new end of the window were dropped.
+  if ( window_end_i < window_end_ ) {
+    present_.clear( window_end_i, window_end_ );
+  }
+  window_end_ = window_end_i;
 
-  flush_();
+  present_.reserve( window_end_i - pushed_i, pushed_i, window_end_i );
+  writer.write_ahead( first_index - pushed_i, data );
+  present_.set( first_index, first_index + data.size() );
 }
 
 void Reassembler::flush_()
 {
   auto& writer = output_.writer();
 
-  for ( auto pushed = writer.bytes_pushed(), available = writer.available_capacity();
-
-        !cache_.empty() && available && pushed == cache_.cbegin()->index;
+  if ( engine_ == Engine::Ring ) {
+    if ( present_.size() ) {
+      const auto pushed_i = writer.bytes_pushed();
+      const auto run = present_.run_length( pushed_i, pushed_i + writer.available_capacity() );
+      present_.clear( pushed_i, pushed_i + run );
+      writer.commit( run );
+    }
+  }
 
-        pushed = writer.bytes_pushed(), available = writer.available_capacity() ) {
-    auto& seg = *cache_.begin();
-    auto len = seg.data.size();
-    writer.push( seg.data.substr( 0UL, max( len, available ) ) );
+  while ( !cache_.empty() && writer.available_capacity() && cache_.begin()->first == writer.bytes_pushed() ) {
+    const auto available = writer.available_capacity();
+    auto seg = cache_.extract( cache_.begin() );
+    auto& slice = seg.mapped();
+    const auto len = min<uint64_t>( slice.length, available );
+    push_( slice.view().substr( 0, len ) );
 
-    if ( len > available ) {
-      seg.data = seg.data.substr( available, len );
-      seg.index += available;
+    if ( len < slice.length ) {
+      slice.offset += len;
+      slice.length -= len;
+      seg.key() += len;
+      cache_.insert( move( seg ) );
     } else {
-      cache_.pop_front();
+      release_( slice );
     }
   }
 
   if ( last_index_set && writer.bytes_pushed() == last_index_ ) {
-    if ( !cache_.empty() ) {
+    if ( has_pending() ) {
       throw exception();
     }
     writer.close();
   }
 }
 
+void Reassembler::push_( string_view data )
+{
+  auto& writer = output_.writer();
+  if ( output_.storage() == ByteStream::Storage::Chunked ) {
+    writer.push( string { data } );
+  } else {
+    writer.write_ahead( 0, data );
+    writer.commit( data.size() );
+  }
+}
+
+vector<Reassembler::ByteRange> Reassembler::pending_ranges( size_t max_ranges ) const
+{
+  vector<ByteRange> ranges;
+  const auto pushed_i = writer().bytes_pushed();
+
+  if ( engine_ == Engine::Ring ) {
+    const auto window_end_i = pushed_i + writer().available_capacity();
+    for ( auto pos = pushed_i; present_.size() && ranges.size() < max_ranges; ) {
+      const auto first = present_.next_set( pos, window_end_i );
+      if ( first == window_end_i ) {
+        break;
+      }
+      pos = first + present_.run_length( first, window_end_i );
+      ranges.push_back( { first, pos } );
+    }
+    return ranges;
+  }
+
+  for ( const auto& [index, slice] : cache_ ) {
+    if ( !ranges.empty() && ranges.back().last == index ) {
+      ranges.back().last += slice.length;
+    } else if ( ranges.size() < max_ranges ) {
+      ranges.push_back( { index, index + slice.length } );
+    } else {
+      break;
+    }
+  }
+  return ranges;
+}
+
+vector<Reassembler::ByteRange> Reassembler::holes( size_t max_ranges ) const
+{
+  auto ranges = pending_ranges( max_ranges );
+  auto hole_begin_i = writer().bytes_pushed();
+  for ( auto& range : ranges ) {
+    range = { exchange( hole_begin_i, range.last ), range.first };
+  }
+  return ranges;
+}
+
 // How many bytes are stored in the Reassembler itself?
 // This function is for testing only; don't add extra state to support it.
 uint64_t Reassembler::count_bytes_pending() const
 {
-  uint64_t count = 0;
-  for ( auto it : cache_ ) {
-    count += it.data.size();
+  uint64_t count = present_.count();
+  for ( const auto& [index, slice] : cache_ ) {
+    count += slice.length;
   }
   return count;
 }
@@ -1,21 +1,63 @@
 #pragma once
 
+#include "buffer_pool.hh"
 #include "byte_stream.hh"
-#include <list>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
-struct CachedSegment
+// A ring of presence bits for stream indices (index `i` maps to bit `i % size()`).
+class PresenceBitmap
 {
-  std::string data;
-  uint64_t index;
+public:
+  uint64_t size() const { return words_.size() * 64; }
+
+  // Grow to at least `bits`, keeping the bits of stream indices [from, to)
+  void reserve( uint64_t bits, uint64_t from, uint64_t to );
+
+  void set( uint64_t from, uint64_t to ) { update_( from, to, true ); }
+  void clear( uint64_t from, uint64_t to ) { update_( from, to, false ); }
+  bool test( uint64_t index ) const;
 
-  friend bool operator<( CachedSegment const& seg, uint64_t const& _index ) { return seg.index < _index; }
+  uint64_t run_length( uint64_t from, uint64_t to ) const; // How many indices from `from` (up to `to`) are set?
+  uint64_t next_set( uint64_t from, uint64_t to ) const;   // First set index in [from, to), or `to` if none
+  uint64_t count() const { return count_; }                // How many bits are set in total?
+
+private:
+  std::vector<uint64_t> words_ {};
+  uint64_t count_ = 0;
+  void update_( uint64_t from, uint64_t to, bool value );
+};
+
+// A refcounted slice of an inserted substring. Pending data is trimmed by adjusting the offset and length,
+// and several slices can share one buffer, so nothing is copied until the bytes go to the output. (A slice
+// much smaller than its buffer gets a copy instead, so that a few bytes never pin a whole segment.)
+struct PayloadSlice
+{
+  std::shared_ptr<const std::string> buffer;
+  size_t offset;
+  size_t length;
+
+  std::string_view view() const { return std::string_view { *buffer }.substr( offset, length ); }
 };
 
 class Reassembler
 {
 public:
+  // Where out-of-order bytes wait until the gap before them is filled.
+  enum class Engine
+  {
+    IntervalMap, // Pending segments in an ordered map (works with any output storage).
+    // Pending bytes are written ahead into the output stream's own ring, with a bitmap of which ones are
+    // present: an insert is one copy, and flushing just pushes the present prefix. Needs ring-based storage.
+    Ring,
+  };
+
   // Construct Reassembler to write into given ByteStream.
-  explicit Reassembler( ByteStream&& output ) : output_( std::move( output ) ), cache_() {}
+  explicit Reassembler( ByteStream&& output, Engine engine = Engine::IntervalMap );
 
   /*
    * Insert a new substring to be reassembled into a ByteStream.
@@ -43,6 +85,55 @@ public:
   // This function is for testing only; don't add extra state to support it.
   uint64_t count_bytes_pending() const;
 
+  // Are any bytes stored in the Reassembler itself? (O(1), unlike count_bytes_pending)
+  bool has_pending() const { return !cache_.empty() || present_.count(); }
+
+  Engine engine() const { return engine_; }
+
+  /*
+   * Limits on the IntervalMap engine's pending store, against peers that scatter many tiny fragments over the
+   * window. Its memory is each segment's bookkeeping plus the buffers the segments' slices keep alive (each
+   * counted once, however many slices share it). When a limit is exceeded, the farthest-out segments are
+   * evicted (their bytes must be resent). The defaults leave room for a few MiB of window in full-sized
+   * segments. The Ring engine's memory is fixed (the output ring plus one bit per byte), so it has no limits.
+   */
+  // Bookkeeping per pending segment: a tree node (three links and a color) holding the index and slice
+  static constexpr uint64_t SEGMENT_METADATA_BYTES
+    = sizeof( std::pair<const uint64_t, PayloadSlice> ) + 4 * sizeof( void* );
+  struct Limits
+  {
+    uint64_t max_segments = 4096;
+    uint64_t max_memory_bytes = uint64_t { 16 } << 20;
+  };
+  uint64_t memory_pending() const { return cache_.size() * SEGMENT_METADATA_BYTES + buffer_bytes_; }
+  void set_limits( const Limits& limits );
+
+  struct Stats
+  {
+    uint64_t fast_path_inserts {}; // in-order data written straight to the output
+    uint64_t slow_path_inserts {}; // out-of-order data that went to the pending store
+    uint64_t fragments {};         // pending segments created (an insert that fills several gaps creates several)
+    uint64_t peak_segments {};     // most segments pending at once
+    uint64_t evicted_segments {};  // pending segments dropped to stay within the limits
+    uint64_t evicted_bytes {};     // bytes in those segments
+  };
+  const Stats& stats() const { return stats_; }
+  uint64_t segments_pending() const { return cache_.size(); }
+  uint64_t buffer_bytes_pending() const { return buffer_bytes_; } // held by pending slices' buffers
+
+  // A range of stream indices [first, last)
+  struct ByteRange
+  {
+    uint64_t first;
+    uint64_t last;
+  };
+
+  // The pending ranges past the write position in stream order, touching ones merged (at most `max_ranges`)
+  std::vector<ByteRange> pending_ranges( size_t max_ranges = SIZE_MAX ) const;
+
+  // The holes between the write position and each of those pending ranges
+  std::vector<ByteRange> holes( size_t max_ranges = SIZE_MAX ) const;
+
   // Access output stream reader
   Reader& reader() { return output_.reader(); }
   const Reader& reader() const { return output_.reader(); }
@@ -52,7 +143,29 @@ public:
 
 private:
   ByteStream output_;
-  std::list<CachedSegment> cache_;
+  Engine engine_;
+  Stats stats_ {};
+  Limits limits_ {};
+
+  // Pending slices keyed by stream index. They never overlap, so the slices that a new one overlaps are found
+  // with one O(log n) lookup, and only the gaps between them are added (as slices of the new buffer).
+  using Segments = std::map<uint64_t,
+                            PayloadSlice,
+                            std::less<>,
+                            PoolAllocator<std::pair<const uint64_t, PayloadSlice>>>;
+  Segments cache_ {};
+  uint64_t buffer_bytes_ = 0; // size of every buffer that some pending slice refers to, counted once each
+  void cache_segment_( uint64_t first_index, const PayloadSlice& slice );
+  void release_( const PayloadSlice& slice ); // a pending slice is about to go: stop counting a buffer it was last
+                                              // to refer to
+  void enforce_limits_(); // evict the farthest-out segments while over the limits
+  void push_( std::string_view data ); // copy into the output stream
+
+  // Ring engine: which bytes past the write position have been written ahead, and the end of the window then.
+  PresenceBitmap present_ {};
+  uint64_t window_end_ = 0;
+  void write_ahead_( uint64_t first_index, std::string_view data );
+
   uint64_t last_index_ = 0;
   bool last_index_set = false;
   void flush_(); // flush cached data to output if able(best effort)
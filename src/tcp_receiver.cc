@@ -1,5 +1,6 @@
 #include "tcp_receiver.hh"
 #include "wrapping_integers.hh"
+#include <algorithm>
 #include <cstdint>
 #include <limits>
 
@@ -12,24 +13,166 @@ void TCPReceiver::receive( TCPSenderMessage message )
   }
   if ( message.SYN && !ISN.has_value() ) {
     ISN.emplace( message.seqno );
+    sack_permitted_ = message.SACK_permitted;
+    peer_window_scale_ = message.window_scale.has_value();
+    if ( timestamps_enabled_ && message.TSval ) {
+      ts_recent_ = message.TSval;
+    }
   }
+  const bool has_payload = !message.payload.empty();
   if ( ISN.has_value() ) {
 
     auto abs_seqno = message.seqno.unwrap( ISN.value(), writer().bytes_pushed() );
-    if ( !( abs_seqno == 0 && !message.SYN && !message.payload.empty() ) ) {
+
+    // PAWS: a TSval older than TS.Recent marks an old duplicate (RST is exempt, so a reset still gets through)
+    if ( ts_recent_ && message.TSval && !message.RST ) {
+      if ( static_cast<int32_t>( *message.TSval - *ts_recent_ ) < 0 ) {
+        paws_rejected_++;
+        return;
+      }
+      // Remember the TSval of an acceptable segment that covers our last ackno, i.e. the one the next ACK
+      // answers (RFC 7323 4.3). A segment outside the window must not move TS.Recent.
+      const uint64_t last_ack = writer().bytes_pushed() + 1 + writer().is_closed();
+      const uint64_t window_end = last_ack + writer().available_capacity();
+      const uint64_t length = message.sequence_length();
+      const bool acceptable = length ? abs_seqno < window_end && abs_seqno + length > last_ack
+                                     : abs_seqno >= last_ack && abs_seqno <= window_end;
+      if ( acceptable && abs_seqno <= last_ack ) {
+        ts_recent_ = message.TSval;
+      }
+    }
+    if ( !( abs_seqno == 0 && !message.SYN && has_payload ) ) {
       // special case: trying to override seqno occupied by SYN.
       uint64_t stream_index = abs_seqno ? abs_seqno - 1 : 0;
-      reassembler_.insert( stream_index, message.payload, message.FIN );
+      const uint64_t end_index = stream_index + message.payload.size();
+      reassembler_.insert( stream_index, move( message.payload ), message.FIN );
+      if ( has_payload && end_index > writer().bytes_pushed() ) {
+        last_received_ = end_index - 1;
+      }
+    }
+  }
+  if ( autotuning_ && has_payload ) {
+    autotuning_->last_receipt = autotuning_->now;
+    autotune_();
+  }
+}
+
+void TCPReceiver::enable_autotuning( uint64_t max_capacity )
+{
+  const uint64_t capacity = writer().available_capacity() + reader().bytes_buffered();
+  autotuning_.emplace( Autotuning { .min_capacity = capacity, .max_capacity = max( max_capacity, capacity ) } );
+}
+
+void TCPReceiver::tick( uint64_t ms_since_last_tick )
+{
+  if ( !autotuning_ ) {
+    return;
+  }
+  auto& at = *autotuning_;
+  at.now += ms_since_last_tick;
+
+  // Idle: give the memory back, and start measuring afresh when data flows again.
+  const uint64_t capacity = writer().available_capacity() + reader().bytes_buffered();
+  if ( at.now - at.last_receipt >= AUTOTUNE_IDLE_MS && capacity > at.min_capacity && !reader().bytes_buffered()
+       && !reassembler_.has_pending() && !at.shrink_edge ) {
+    at.shrink_edge = reader().bytes_popped() + capacity;
+    at.rtt_time.reset();
+    at.space = 0;
+  }
+
+  // The peer may fill the window it was offered, so shrink only as far as the application has read up to it
+  // (RFC 7323 2.4): the right edge stays put until the capacity is back to its original size.
+  if ( at.shrink_edge ) {
+    const uint64_t popped = reader().bytes_popped();
+    const uint64_t target = max( at.min_capacity, *at.shrink_edge > popped ? *at.shrink_edge - popped : 0 );
+    if ( target < capacity ) {
+      reader().set_capacity( target );
+    }
+    if ( target == at.min_capacity ) {
+      at.shrink_edge.reset();
     }
   }
 }
 
+void TCPReceiver::autotune_()
+{
+  auto& at = *autotuning_;
+  const uint64_t pushed = writer().bytes_pushed();
+
+  // Sample the RTT each time the data covering a previously advertised window has arrived.
+  if ( !at.rtt_time || pushed >= at.rtt_index ) {
+    if ( at.rtt_time ) {
+      const uint64_t sample = max<uint64_t>( at.now - *at.rtt_time, 1 );
+      at.rtt = at.rtt ? ( 7 * at.rtt + sample ) / 8 : sample;
+    }
+    at.rtt_index = pushed + writer().available_capacity();
+    at.rtt_time = at.now;
+    if ( !at.rtt ) {
+      return;
+    }
+  }
+
+  if ( !at.rtt || at.now - at.space_time < at.rtt ) {
+    return;
+  }
+
+  // Once per RTT: make room for twice what the application drained, if that is more than it has now.
+  const uint64_t popped = reader().bytes_popped();
+  const uint64_t copied = popped - at.space_popped;
+  const uint64_t capacity = writer().available_capacity() + reader().bytes_buffered();
+  if ( copied > at.space ) {
+    at.space = copied;
+    const uint64_t target = min( 2 * copied, at.max_capacity );
+    if ( target > capacity ) {
+      reader().set_capacity( target );
+      at.shrink_edge.reset();
+    }
+  }
+  at.space_time = at.now;
+  at.space_popped = popped;
+}
+
 TCPReceiverMessage TCPReceiver::send() const
 {
   auto ack_seqno = ISN.has_value()
                      ? Wrap32::wrap( ISN.has_value() + writer().bytes_pushed() + writer().is_closed(), ISN.value() )
                      : std::optional<Wrap32>();
+  const uint8_t shift = window_scale();
   uint64_t available_capacity
-    = min( writer().available_capacity(), static_cast<uint64_t>( std::numeric_limits<uint16_t>::max() ) );
-  return { ack_seqno, static_cast<uint16_t>( available_capacity ), reader().has_error() };
+    = min( writer().available_capacity(), static_cast<uint64_t>( std::numeric_limits<uint16_t>::max() ) << shift );
+  if ( autotuning_ && autotuning_->shrink_edge ) {
+    // Until tick() shrinks the capacity, reads must not move the right edge past where it is being held
+    const uint64_t edge = *autotuning_->shrink_edge;
+    const uint64_t pushed = writer().bytes_pushed();
+    available_capacity = min( available_capacity, edge > pushed ? edge - pushed : 0 );
+  }
+  available_capacity &= ~( ( uint64_t { 1 } << shift ) - 1 );
+  TCPReceiverMessage msg { ack_seqno, static_cast<uint32_t>( available_capacity ), reader().has_error() };
+
+  msg.TSecr = ts_recent_;
+
+  // Tell the sender which bytes past the ackno already arrived (stream index + 1 = absolute seqno).
+  // The first block covers the latest segment (RFC 2018 4); the others follow the ackno in stream order.
+  if ( sack_permitted_ ) {
+    auto ranges = reassembler_.pending_ranges( TCPReceiverMessage::MAX_SACK_BLOCKS );
+    if ( last_received_ ) {
+      const auto covers_latest = [&]( const auto& range ) {
+        return range.first <= *last_received_ && *last_received_ < range.last;
+      };
+      if ( const auto it = find_if( ranges.begin(), ranges.end(), covers_latest ); it != ranges.end() ) {
+        rotate( ranges.begin(), it, next( it ) );
+      } else {
+        const auto all = reassembler_.pending_ranges(); // the latest lies beyond the nearest holes
+        if ( const auto latest = find_if( all.begin(), all.end(), covers_latest ); latest != all.end() ) {
+          ranges.pop_back();
+          ranges.insert( ranges.begin(), *latest );
+        }
+      }
+    }
+    for ( const auto& range : ranges ) {
+      msg.sack.push_back(
+        { Wrap32::wrap( range.first + 1, ISN.value() ), Wrap32::wrap( range.last + 1, ISN.value() ) } );
+    }
+  }
+  return msg;
 }
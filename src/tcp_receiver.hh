@@ -20,6 +20,37 @@ public:
   // The TCPReceiver sends TCPReceiverMessages to the peer's TCPSender.
   TCPReceiverMessage send() const;
 
+  /*
+   * Receive-buffer autotuning (off by default): once per round trip, grow the inbound stream's capacity to
+   * twice what the application popped during that round trip (up to `max_capacity`), so that the window
+   * covers the bandwidth-delay product. After AUTOTUNE_IDLE_MS without data, shrink back to the original size,
+   * as fast as the application's reads let the window's right edge stay where it was advertised.
+   */
+  static constexpr uint64_t AUTOTUNE_IDLE_MS = 1000;
+  void enable_autotuning( uint64_t max_capacity );
+
+  // Time has passed by the given # of milliseconds (only needed for autotuning)
+  void tick( uint64_t ms_since_last_tick );
+
+  /*
+   * Window scaling (RFC 7323, off by default): the local SYN announces `shift`. If the peer's SYN carried the
+   * option too, advertise windows of up to 65,535 << shift, rounded down to a multiple of 1 << shift so that
+   * nothing is lost when they are shifted into the segment header.
+   */
+  void enable_window_scale( uint8_t shift ) { window_shift_ = shift; }
+  uint8_t window_scale() const { return window_shift_ && peer_window_scale_ ? *window_shift_ : 0; } // negotiated
+
+  /*
+   * Timestamps (RFC 7323, off by default): if the peer's SYN carried a TSval too, echo the TSval of the latest
+   * in-order segment in TSecr, and drop segments whose TSval is older than that (PAWS: protection against
+   * wrapped sequence numbers, whose old duplicates would otherwise unwrap into the current window).
+   */
+  void enable_timestamps() { timestamps_enabled_ = true; }
+  uint64_t paws_rejected() const { return paws_rejected_; } // segments dropped by PAWS
+
+  // Autotuning's estimate of the round-trip time in milliseconds (0 until measured)
+  uint64_t rtt_estimate() const { return autotuning_ ? autotuning_->rtt : 0; }
+
   // Access the output
   const Reassembler& reassembler() const { return reassembler_; }
   Reader& reader() { return reassembler_.reader(); }
@@ -29,4 +60,34 @@ public:
 private:
   Reassembler reassembler_;
   std::optional<Wrap32> ISN = std::nullopt;
+  bool sack_permitted_ = false;              // did the peer's SYN permit selective acknowledgments?
+  bool peer_window_scale_ = false;           // did the peer's SYN carry the window scale option?
+  std::optional<uint8_t> window_shift_ = {}; // the shift our SYN announces, if window scaling is enabled
+  bool timestamps_enabled_ = false;
+  std::optional<uint32_t> ts_recent_ = {}; // TS.Recent: set once timestamps are negotiated
+  uint64_t paws_rejected_ = 0;
+  std::optional<uint64_t> last_received_ = {}; // stream index of the latest out-of-order byte, for SACK
+
+  struct Autotuning
+  {
+    uint64_t min_capacity;
+    uint64_t max_capacity;
+    uint64_t now = 0;
+    uint64_t last_receipt = 0;
+
+    // RTT estimate: the time it takes to receive one advertised window's worth of data
+    uint64_t rtt = 0;
+    uint64_t rtt_index = 0; // right edge of the window advertised at rtt_time
+    std::optional<uint64_t> rtt_time = std::nullopt;
+
+    // Bytes popped by the application over the last round trip
+    uint64_t space_time = 0;
+    uint64_t space_popped = 0;
+    uint64_t space = 0;
+
+    // Shrinking after idle: the right edge already offered to the peer, which the window must not retract
+    std::optional<uint64_t> shrink_edge = std::nullopt;
+  };
+  std::optional<Autotuning> autotuning_ = std::nullopt;
+  void autotune_();
 };
@@ -4,8 +4,8 @@
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 #include "wrapping_integers.hh"
+#include <algorithm>
 #include <cassert>
-#include <cmath>
 #include <cstdint>
 #include <sys/types.h>
 
@@ -18,67 +18,186 @@ uint64_t TCPSender::sequence_numbers_in_flight() const
   return sent_seqno_ - acked_seqno_;
 }
 
-// This function is for testing only; don't add extra state to support it.
 uint64_t TCPSender::consecutive_retransmissions() const
 {
-  return static_cast<uint64_t>( log2( (double)current_RTO_ms_ / (double)initial_RTO_ms_ ) );
+  return consecutive_retransmissions_;
+}
+
+void TCPSender::enable_adaptive_rto( uint64_t min_RTO_ms, uint64_t max_RTO_ms )
+{
+  rtt_estimator_.emplace( min_RTO_ms, max_RTO_ms );
+}
+
+optional<uint64_t> TCPSender::smoothed_rtt() const
+{
+  return rtt_estimator_ ? rtt_estimator_->srtt() : nullopt;
+}
+
+bool TCPSender::stream_sent() const
+{
+  return writer().is_closed() && sent_seqno_ == writer().bytes_pushed() + 2; // SYN + stream + FIN
+}
+
+uint64_t TCPSender::congestion_window() const
+{
+  return congestion_ ? congestion_->window() : UINT64_MAX;
+}
+
+void TCPSender::set_congestion_control( CongestionControl::Algorithm algorithm )
+{
+  congestion_algorithm_ = algorithm;
+  congestion_ = CongestionControl::make( algorithm, max_payload_size_ );
+}
+
+void TCPSender::enable_pacing( uint64_t rate, double gain, uint64_t burst_segments )
+{
+  burst_segments = max<uint64_t>( burst_segments, 1 );
+  pacing_.emplace( Pacing { .rate = rate,
+                            .gain = gain,
+                            .burst_segments = burst_segments,
+                            .tokens = static_cast<double>( burst_segments * max_payload_size_ ),
+                            .rtt = nullopt } );
+}
+
+optional<uint64_t> TCPSender::pacing_rate() const
+{
+  if ( !pacing_ ) {
+    return nullopt;
+  }
+  if ( pacing_->rate ) {
+    return pacing_->rate;
+  }
+  double rate = 0;
+  if ( const auto cc_rate = congestion_ ? congestion_->pacing_rate() : nullopt ) {
+    rate = static_cast<double>( *cc_rate );
+  } else if ( pacing_->rtt ) {
+    // Spread the window over a round trip (at least a segment's worth, so a small window still drains)
+    const auto window = max( min( congestion_window(), windows_size_ ), max_payload_size_ );
+    rate = static_cast<double>( window ) * 1000 / static_cast<double>( max<uint64_t>( *pacing_->rtt, 1 ) );
+  } else {
+    return nullopt; // nothing measured yet: send the initial window unpaced
+  }
+  return max<uint64_t>( static_cast<uint64_t>( pacing_->gain * rate ), 1 );
+}
+
+void TCPSender::set_max_payload_size( uint64_t size )
+{
+  max_payload_size_ = size;
+  if ( congestion_ ) {
+    congestion_->set_mss( size ); // windows are counted in segments of the new size
+  }
+  if ( pacing_ ) {
+    pacing_->tokens = static_cast<double>( pacing_->burst_segments * size ); // and so is the pacing bucket
+  }
 }
 
 void TCPSender::push( const TransmitFunction& transmit )
 {
+  // Fast retransmit: resend the segment the receiver's duplicate ACKs ask for (and other SACK holes)
+  if ( exchange( retransmit_pending_, false ) && !outstandings_.empty() ) {
+    retransmit_( transmit, false );
+  }
+
   if ( state_ == HANDSHAKE || state_ == ZERO_WINDOW || state_ == FINISHED ) {
     return;
   }
 
   auto seqno_in_flight = sent_seqno_ - acked_seqno_;
-  auto window_size = static_cast<uint64_t>( windows_size_ );
+  auto window_size = windows_size_;
   auto seqno_available = window_size > seqno_in_flight ? window_size - seqno_in_flight : 0;
 
   // Special case: if windows size == 0,construct ZERO_WINDOW probe.
   if ( !window_size ) {
     seqno_available = 1;
+  } else {
+    // The congestion window limits what is still in the network. SACKed segments have left it, and so
+    // (during fast recovery) has one segment per duplicate ACK.
+    const auto dup_acked = recovery_point_ ? dup_acks_ * max_payload_size_ : 0;
+    const auto pipe = seqno_in_flight - min( seqno_in_flight, max( sacked_bytes_, dup_acked ) );
+    const auto cwnd = congestion_window();
+    seqno_available = min( seqno_available, cwnd > pipe ? cwnd - pipe : 0 );
   }
 
+  const bool paced = pacing_rate().has_value();
+
   while ( seqno_available ) {
     // Construct sender message
-    TCPSenderMessage msg = make_empty_message();
-    msg.SYN = ( state_ == CLOSED );
-    while ( msg.sequence_length() < seqno_available && reader().bytes_buffered()
-            && msg.payload.size() < TCPConfig::MAX_PAYLOAD_SIZE ) {
-      msg.payload.append( reader().peek() );
-      reader().pop( 1UL );
-    }
-    msg.FIN = reader().is_finished() && msg.sequence_length() < seqno_available;
+    OutstandingSegment seg { .seqno = sent_seqno_, .sent_at = now_ms_ };
+    seg.SYN = ( state_ == CLOSED );
+    seg.RST = reader().has_error();
+
+    // Take as much of the unsent data as the window and MSS allow; it stays buffered until acknowledged
+    const uint64_t unsent = writer().bytes_pushed() - bytes_sent_;
+    const auto payload_size = min( { seqno_available - seg.SYN, max_payload_size_, unsent } );
+    seg.FIN = writer().is_closed() && payload_size == unsent && seg.SYN + payload_size < seqno_available;
+    seg.length = static_cast<uint32_t>( seg.SYN + payload_size + seg.FIN );
 
     // Abort empty packet
-    if ( msg.payload.empty() && !( msg.SYN || msg.FIN || msg.RST ) ) {
+    if ( !payload_size && !( seg.SYN || seg.FIN || seg.RST ) ) {
       break;
     }
 
+    // Pacing: the segment waits for tick() to refill an empty bucket. It may overdraw it (the debt holds back
+    // the next one), so that no segment, however its length compares to the bucket's depth, waits forever.
+    if ( paced ) {
+      if ( pacing_->tokens <= 0 ) {
+        break;
+      }
+      pacing_->tokens -= seg.length;
+    }
+
     // Transmit and push to outstandings
-    transmit( msg );
-    outstandings_.push_back( msg );
+    transmit( make_message_( seg ) );
+    if ( congestion_ ) {
+      congestion_->on_send( now_ms_, seg.length, sent_seqno_ - acked_seqno_ );
+    }
 
     // Update state machine
-    if ( msg.SYN ) {
+    if ( seg.SYN ) {
       state_ = HANDSHAKE;
     }
-    if ( msg.FIN ) {
+    if ( seg.FIN ) {
       state_ = FINISHED;
     }
     if ( !window_size ) {
       state_ = ZERO_WINDOW;
       zw_probe_seqno.emplace( sent_seqno_ );
     }
-    sent_seqno_ += msg.sequence_length();
+    outstandings_.push_back( seg );
+    sent_seqno_ += seg.length;
+    bytes_sent_ += payload_size;
     if ( !timer_.started() ) {
       timer_.reset( current_RTO_ms_ );
       timer_.enable();
     }
 
     // Update seqno available to support multiple packet in a push
-    seqno_available -= msg.sequence_length();
-    seqno_available = reader().bytes_buffered() ? seqno_available : 0;
+    seqno_available -= seg.length;
+    seqno_available = writer().bytes_pushed() > bytes_sent_ ? seqno_available : 0;
+  }
+}
+
+TCPSenderMessage TCPSender::make_message_( const OutstandingSegment& seg ) const
+{
+  TCPSenderMessage msg { .seqno = Wrap32::wrap( seg.seqno, isn_ ),
+                         .SYN = seg.SYN,
+                         .payload = string(),
+                         .FIN = seg.FIN,
+                         .RST = seg.RST,
+                         .SACK_permitted = seg.SYN && sack_enabled_,
+                         .window_scale = seg.SYN ? window_scale_ : nullopt,
+                         .MSS = seg.SYN ? offered_MSS_ : nullopt,
+                         .TSval = timestamp_() };
+  // The SYN occupies absolute seqno 0, so stream index = absolute seqno - 1 for every other segment
+  copy_payload_( seg.seqno + seg.SYN - 1, seg.payload_size(), msg.payload );
+  return msg;
+}
+
+void TCPSender::copy_payload_( uint64_t stream_index, uint64_t size, string& payload ) const
+{
+  payload.reserve( size );
+  for ( const auto region : reader().peek_range( stream_index - reader().bytes_popped(), size ) ) {
+    payload.append( region );
   }
 }
 
@@ -88,7 +207,13 @@ TCPSenderMessage TCPSender::make_empty_message() const
            .SYN = false,
            .payload = string(),
            .FIN = false,
-           .RST = reader().has_error() };
+           .RST = reader().has_error(),
+           .TSval = timestamp_() };
+}
+
+optional<uint32_t> TCPSender::timestamp_() const
+{
+  return timestamps_enabled_ ? optional { static_cast<uint32_t>( now_ms_ ) } : nullopt; // 1 ms clock ticks
 }
 
 void TCPSender::receive( const TCPReceiverMessage& msg )
@@ -96,7 +221,7 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
   if ( msg.RST ) {
     writer().set_error();
   }
-  windows_size_ = msg.window_size;
+  const auto previous_window_size = exchange( windows_size_, msg.window_size );
 
   // Check if the ACK packet have set ackno.If so,decode the ackno and check validity.
   bool ACK = msg.ackno.has_value();
@@ -108,50 +233,169 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
     return;
   }
 
+  // Sequence numbers that newly reached the peer, cumulatively or by SACK, and an RTT sample if there is one
+  uint64_t delivered = 0;
+  optional<uint64_t> rtt_sample;
+  bool recovered = false; // this ACK ended fast recovery
+
   // Handle ACK
   if ( msg_acked_seqno > acked_seqno_ ) {
     if ( state_ == HANDSHAKE ) {
       state_ = STREAMING;
     }
 
-    // Traverse in-flight packets
+    // Retire the in-flight segments the ACK covers, and drop their payload from the stream
     while ( !outstandings_.empty() ) {
-      // Compute seqno that should be acked for the current in-flight packet
-      const auto& pkt = *outstandings_.begin();
-      const auto pkt_seqno = pkt.seqno.unwrap( isn_, acked_seqno_ );
-      const auto pkt_seqno_to_be_acked = pkt_seqno + pkt.sequence_length();
-      if ( msg_acked_seqno >= pkt_seqno_to_be_acked ) {
-        if ( state_ == ZERO_WINDOW && pkt_seqno == zw_probe_seqno ) {
-          // assert(zero_window_probe_pkt_seqno.has_value());
-          state_ = STREAMING;
-          zw_probe_seqno.reset();
-        }
-        outstandings_.pop_front();
-      } else {
+      const auto& seg = outstandings_.front();
+      if ( msg_acked_seqno < seg.seqno + seg.length ) {
         break;
       }
+      if ( state_ == ZERO_WINDOW && seg.seqno == zw_probe_seqno ) {
+        // assert(zero_window_probe_pkt_seqno.has_value());
+        state_ = STREAMING;
+        zw_probe_seqno.reset();
+      }
+      if ( !seg.retransmitted && !seg.sacked ) {
+        rtt_sample = now_ms_ - seg.sent_at;
+      }
+      if ( seg.sacked ) {
+        sacked_bytes_ -= seg.length;
+      } else {
+        delivered += seg.length;
+      }
+      reader().pop( seg.payload_size() );
+      outstandings_.pop_front();
+    }
+
+    // With timestamps, every ACK that moves the window is timed by the TSval it echoes, retransmitted or not
+    if ( timestamps_enabled_ && msg.TSecr ) {
+      rtt_sample = static_cast<uint32_t>( now_ms_ ) - *msg.TSecr;
+    }
+    if ( pacing_ && rtt_sample ) {
+      pacing_->rtt = pacing_->rtt ? ( 7 * *pacing_->rtt + *rtt_sample ) / 8 : *rtt_sample;
+    }
+
+    // A partial ACK during recovery means the next segment was lost too (NewReno); a full ACK ends recovery.
+    if ( recovery_point_ && msg_acked_seqno < *recovery_point_ ) {
+      retransmit_pending_ = true;
+    } else if ( exchange( recovery_point_, nullopt ) ) {
+      recovered = true;
     }
+    dup_acks_ = 0;
 
     // Update State Machine
-    current_RTO_ms_ = initial_RTO_ms_;
+    if ( rtt_estimator_ && rtt_sample ) {
+      base_RTO_ms_ = rtt_estimator_->sample( *rtt_sample );
+    }
+    current_RTO_ms_ = base_RTO_ms_;
+    consecutive_retransmissions_ = 0;
     acked_seqno_ = msg_acked_seqno;
     timer_.reset( current_RTO_ms_ );
     if ( !outstandings_.empty() ) {
       timer_.enable();
     }
+  } else if ( fast_retransmit_enabled_ && msg_acked_seqno == acked_seqno_ && !outstandings_.empty()
+              && state_ != ZERO_WINDOW && msg.window_size == previous_window_size ) {
+    // Duplicate ACK: the receiver got a segment past a hole. The third one starts fast recovery.
+    if ( ++dup_acks_ == DUP_ACK_THRESHOLD && !recovery_point_ ) {
+      recovery_point_ = sent_seqno_;
+      retransmit_pending_ = true;
+      if ( congestion_ ) {
+        congestion_->on_loss( now_ms_, sent_seqno_ - acked_seqno_ );
+      }
+    }
+  }
+
+  // Mark the outstanding segments that the peer reports holding already (only if we offered SACK)
+  if ( sack_enabled_ ) {
+    for ( const auto& block : msg.sack ) {
+      const auto left = block.left.unwrap( isn_, acked_seqno_ );
+      const auto right = block.right.unwrap( isn_, acked_seqno_ );
+      for ( auto& seg : outstandings_ ) {
+        if ( !seg.sacked && seg.seqno >= left && seg.seqno + seg.length <= right ) {
+          seg.sacked = true;
+          delivered += seg.length;
+          sacked_bytes_ += seg.length;
+        }
+      }
+    }
+  }
+
+  if ( congestion_ && delivered ) {
+    congestion_->on_ack( now_ms_, delivered, sent_seqno_ - acked_seqno_, rtt_sample );
+  }
+  if ( congestion_ && recovered ) {
+    congestion_->on_recovered( now_ms_ ); // after the ACK that ended recovery, which does not grow the window
   }
 }
 
 void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit )
 {
+  now_ms_ += ms_since_last_tick;
   if ( timer_.started() ) {
     timer_.tick( ms_since_last_tick );
     if ( timer_.goes_off() ) {
-      current_RTO_ms_ = state_ == ZERO_WINDOW ? current_RTO_ms_ : 2 * current_RTO_ms_;
+      if ( state_ != ZERO_WINDOW ) {
+        current_RTO_ms_ = rtt_estimator_ ? rtt_estimator_->backoff( current_RTO_ms_ ) : 2 * current_RTO_ms_;
+        consecutive_retransmissions_++;
+      }
       timer_.reset( current_RTO_ms_ );
       timer_.enable();
       // assert(!outstandings_.empty());
-      transmit( *outstandings_.begin() );
+      if ( congestion_ && state_ != ZERO_WINDOW ) {
+        congestion_->on_rto( now_ms_, sent_seqno_ - acked_seqno_ );
+      }
+      recovery_point_.reset();
+      dup_acks_ = 0;
+      retransmit_pending_ = false;
+      retransmit_( transmit, true );
+
+      // The receiver may have reneged on what it SACKed (dropping it to make room), so forget the scoreboard
+      // until it reports those segments again (RFC 2018 8): unmarked, they are retransmitted in turn.
+      for ( auto& seg : outstandings_ ) {
+        seg.sacked = false;
+      }
+      sacked_bytes_ = 0;
+    }
+  }
+
+  // Refill the pacing bucket, and send what it now allows. It holds a few segments' worth of tokens, or one
+  // tick's worth if more: ticks are the only clock here, so a bucket any smaller would cap the rate.
+  if ( pacing_ ) {
+    if ( const auto rate = pacing_rate() ) {
+      const double refill = static_cast<double>( *rate ) * static_cast<double>( ms_since_last_tick ) / 1000;
+      const double depth = max( static_cast<double>( pacing_->burst_segments * max_payload_size_ ), refill );
+      pacing_->tokens = min( pacing_->tokens + refill, depth );
+    }
+    push( transmit );
+  }
+}
+
+void TCPSender::retransmit_( const TransmitFunction& transmit, bool again )
+{
+  // Retransmissions go out at once (the first one even from an empty bucket), but they draw on the pacing
+  // bucket like new segments do
+  const bool paced = pacing_rate().has_value();
+  const auto resend = [&]( OutstandingSegment& seg ) {
+    transmit( make_message_( seg ) );
+    seg.retransmitted = true;
+    if ( paced ) {
+      pacing_->tokens -= seg.length;
+    }
+  };
+  resend( outstandings_.front() );
+
+  // With SACK information, also fill every other hole before the last segment the peer holds.
+  // (Unless `again`, skip the holes already retransmitted once: those copies may still be on their way.)
+  const auto last_sacked = find_if( outstandings_.rbegin(), outstandings_.rend(), []( const auto& seg ) {
+                             return seg.sacked;
+                           } ).base();
+  for ( auto it = next( outstandings_.begin() ); it < last_sacked; ++it ) {
+    if ( !it->sacked && ( again || !it->retransmitted ) ) {
+      if ( paced && pacing_->tokens <= 0 ) {
+        break;
+      }
+      resend( *it );
     }
   }
 }
@@ -1,13 +1,17 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "congestion_control.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <cstdint>
 #include <deque>
 #include <functional>
+#include <memory>
 #include <optional>
 
 class TCPSenderTimer
@@ -39,6 +43,41 @@ private:
   uint64_t expire_duration_;
 };
 
+// RFC 6298 round-trip estimator. SRTT is kept scaled by 8 and RTTVAR by 4, as in Jacobson's original code,
+// so that sub-millisecond adjustments accumulate instead of being rounded away.
+class RTTEstimator
+{
+public:
+  RTTEstimator( uint64_t min_RTO_ms, uint64_t max_RTO_ms ) : min_RTO_ms_( min_RTO_ms ), max_RTO_ms_( max_RTO_ms ) {}
+
+  // Take a measurement (from a segment that was never retransmitted) and return the new RTO
+  uint64_t sample( uint64_t rtt_ms )
+  {
+    if ( !srtt8_ ) {
+      srtt8_ = rtt_ms << 3;
+      rttvar4_ = rtt_ms << 1;
+    } else {
+      const uint64_t srtt = *srtt8_ >> 3;
+      rttvar4_ = rttvar4_ - ( rttvar4_ >> 2 ) + ( rtt_ms > srtt ? rtt_ms - srtt : srtt - rtt_ms );
+      *srtt8_ = *srtt8_ - srtt + rtt_ms;
+    }
+    // RTO = SRTT + max(G, 4 * RTTVAR), with a clock granularity G of 1 ms
+    return std::clamp( ( *srtt8_ >> 3 ) + std::max<uint64_t>( 1, rttvar4_ ), min_RTO_ms_, max_RTO_ms_ );
+  }
+
+  std::optional<uint64_t> srtt() const { return srtt8_ ? std::optional { *srtt8_ >> 3 } : std::nullopt; }
+  uint64_t rttvar() const { return rttvar4_ >> 2; }
+
+  // Back off after a timeout, up to the maximum
+  uint64_t backoff( uint64_t current_RTO_ms ) const { return std::min( 2 * current_RTO_ms, max_RTO_ms_ ); }
+
+private:
+  uint64_t min_RTO_ms_;
+  uint64_t max_RTO_ms_;
+  std::optional<uint64_t> srtt8_ {};
+  uint64_t rttvar4_ {};
+};
+
 enum TCPSenderState
 {
   CLOSED,      // SYN not sent
@@ -56,6 +95,36 @@ public:
     : input_( std::move( input ) ), isn_( isn ), initial_RTO_ms_( initial_RTO_ms ), timer_( initial_RTO_ms )
   {}
 
+  /* Offer the peer selective acknowledgments (on the SYN); SACK blocks it sends then steer retransmissions */
+  void enable_sack() { sack_enabled_ = true; }
+
+  /* Announce on the SYN the largest payload the local receiver accepts (the MSS option) */
+  void offer_mss( uint16_t mss ) { offered_MSS_ = mss; }
+
+  /* Send payloads of up to `size` bytes (the default is TCPConfig::MAX_PAYLOAD_SIZE). Set before sending data. */
+  void set_max_payload_size( uint64_t size );
+
+  /* Announce on the SYN that the local receiver scales its windows by 2^shift (RFC 7323) */
+  void offer_window_scale( uint8_t shift ) { window_scale_ = shift; }
+  void withdraw_window_scale() { window_scale_.reset(); } // the peer's SYN did not carry the option
+
+  /* Stamp every segment with a TSval and time each ACK by its TSecr, retransmissions included (RFC 7323) */
+  void enable_timestamps() { timestamps_enabled_ = true; }
+  void disable_timestamps() { timestamps_enabled_ = false; } // the peer's SYN did not carry timestamps
+
+  /* Retransmit on the third duplicate ACK, and recover the rest of the window NewReno-style */
+  void enable_fast_retransmit() { fast_retransmit_enabled_ = true; }
+
+  /* Derive the RTO from measured round trips (RFC 6298) instead of always starting from the initial RTO */
+  void enable_adaptive_rto( uint64_t min_RTO_ms, uint64_t max_RTO_ms );
+
+  /* Limit the data in flight by a congestion window as well as the receive window */
+  void set_congestion_control( CongestionControl::Algorithm algorithm );
+
+  /* Release new segments through a token bucket refilled in tick(), rather than a window at once. The rate is
+     `rate` bytes/s or, if 0, `gain` times the congestion controller's pacing rate (or the window per RTT). */
+  void enable_pacing( uint64_t rate, double gain, uint64_t burst_segments );
+
   /* Generate an empty TCPSenderMessage */
   TCPSenderMessage make_empty_message() const;
 
@@ -74,6 +143,13 @@ public:
   // Accessors
   uint64_t sequence_numbers_in_flight() const;  // For testing: how many sequence numbers are outstanding?
   uint64_t consecutive_retransmissions() const; // For testing: how many consecutive retransmissions have happened?
+  uint64_t congestion_window() const; // UINT64_MAX without congestion control
+  uint64_t max_payload_size() const { return max_payload_size_; }
+  uint64_t rto() const { return current_RTO_ms_; } // current retransmission timeout, including any backoff
+  std::optional<uint64_t> smoothed_rtt() const;   // SRTT, once measured with the adaptive RTO enabled
+  const CongestionControl* congestion_control() const { return congestion_.get(); }
+  std::optional<uint64_t> pacing_rate() const; // bytes/s; unset without pacing, or until the RTT is measured
+  bool stream_sent() const; // Has the whole outbound stream, FIN included, been sent (if not yet acknowledged)?
   const Writer& writer() const { return input_.writer(); }
   const Reader& reader() const { return input_.reader(); }
   Writer& writer() { return input_.writer(); }
@@ -81,14 +157,62 @@ public:
 private:
   Reader& reader() { return input_.reader(); }
 
+  void retransmit_( const TransmitFunction& transmit, bool again );
+
   ByteStream input_;
   Wrap32 isn_;
   uint64_t initial_RTO_ms_;
 
+  bool sack_enabled_ = false;
+  std::optional<uint8_t> window_scale_ {};
+  std::optional<uint16_t> offered_MSS_ {};
+  bool timestamps_enabled_ = false;
+  uint64_t max_payload_size_ = TCPConfig::MAX_PAYLOAD_SIZE;
+  std::optional<RTTEstimator> rtt_estimator_ {};
+  CongestionControl::Algorithm congestion_algorithm_ = CongestionControl::Algorithm::None;
+  std::unique_ptr<CongestionControl> congestion_ {};
+
   /* Below are non-constant variables. */
-  std::deque<TCPSenderMessage> outstandings_ = {};
 
+  // A segment sent but not yet acknowledged. Its payload stays in the outbound stream (which is only popped
+  // as segments are acknowledged), so a retransmission rebuilds the message from there.
+  struct OutstandingSegment
+  {
+    uint64_t seqno = 0;         // absolute sequence number
+    uint64_t sent_at = 0;       // when it was first sent
+    uint32_t length = 0;        // sequence numbers used, including SYN and FIN
+    bool SYN = false;
+    bool FIN = false;
+    bool RST = false;
+    bool retransmitted = false; // no RTT sample from its ACK, which may be for either copy (Karn's algorithm)
+    bool sacked = false;        // the peer reported (in a SACK block) that it already holds this segment
+
+    uint64_t payload_size() const { return length - SYN - FIN; }
+  };
+  TCPSenderMessage make_message_( const OutstandingSegment& seg ) const;
+  std::optional<uint32_t> timestamp_() const;
+  void copy_payload_( uint64_t stream_index, uint64_t size, std::string& payload ) const;
+
+  // Pacing: a token bucket, counted in bytes. Segments may overdraw it. Retransmissions repair losses, so the
+  // first one is never held back, but they draw on the bucket too.
+  struct Pacing
+  {
+    uint64_t rate;
+    double gain;
+    uint64_t burst_segments;     // depth of the bucket (unless one tick's refill is more)
+    double tokens;               // starts full
+    std::optional<uint64_t> rtt; // smoothed, for pacing by window per RTT
+  };
+  std::optional<Pacing> pacing_ {};
+
+  std::deque<OutstandingSegment> outstandings_ = {};
+  uint64_t bytes_sent_ = 0;   // stream bytes sent at least once (the rest of the buffered bytes are unsent)
+  uint64_t sacked_bytes_ = 0; // sequence numbers in the outstanding segments marked `sacked`
+
+  uint64_t now_ms_ = 0; // sum of all ticks
+  uint64_t base_RTO_ms_ = initial_RTO_ms_; // RTO before backoff
   uint64_t current_RTO_ms_ = initial_RTO_ms_;
+  uint64_t consecutive_retransmissions_ = 0;
   TCPSenderTimer timer_;
 
   TCPSenderState state_ = CLOSED;
@@ -96,7 +220,14 @@ private:
   // Seqno for the zero_window probe, this should be empty if not in ZERO_WINDOW state.
   std::optional<uint64_t> zw_probe_seqno = std::nullopt;
 
+  // Fast retransmit and NewReno fast recovery (RFC 5681, RFC 6582)
+  static constexpr uint64_t DUP_ACK_THRESHOLD = 3;
+  bool fast_retransmit_enabled_ = false;
+  uint64_t dup_acks_ = 0;
+  std::optional<uint64_t> recovery_point_ {}; // highest seqno sent when recovery began; set while recovering
+  bool retransmit_pending_ = false;           // receive() found a loss; the next push() resends the segment
+
   uint64_t acked_seqno_ = 0;
   uint64_t sent_seqno_ = 0;
-  uint16_t windows_size_ = 1;
+  uint64_t windows_size_ = 1;
 };
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "random.hh"
+#include "sender_test_harness.hh"
+#include "tcp_receiver.hh"
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <utility>
+
+// A one-way bottleneck: a drop-tail queue drained at a fixed rate, then a fixed propagation delay.
+// Segments are also dropped at random, the way LossyFdAdapter does it.
+class Bottleneck
+{
+public:
+  struct Config
+  {
+    uint64_t bytes_per_ms;
+    uint64_t delay_ms;
+    size_t queue_limit; // segments
+    uint16_t loss_rate; // out of 65536
+  };
+
+  explicit Bottleneck( const Config& config ) : config_( config ) {}
+
+  void send( const TCPSenderMessage& msg )
+  {
+    if ( queue_.size() >= config_.queue_limit ) {
+      queue_drops_++;
+      return;
+    }
+    if ( config_.loss_rate && static_cast<uint16_t>( rand_() ) < config_.loss_rate ) {
+      return;
+    }
+    queue_.push_back( msg );
+  }
+
+  // Move what the link can carry in one more millisecond onto the wire.
+  void tick( uint64_t now )
+  {
+    credit_ += config_.bytes_per_ms;
+    while ( !queue_.empty() && queue_.front().sequence_length() <= credit_ ) {
+      credit_ -= queue_.front().sequence_length();
+      wire_.emplace( now + config_.delay_ms, std::move( queue_.front() ) );
+      queue_.pop_front();
+    }
+    if ( queue_.empty() ) {
+      credit_ = std::min( credit_, config_.bytes_per_ms ); // an idle link does not save up capacity
+    }
+  }
+
+  std::optional<TCPSenderMessage> arrival( uint64_t now )
+  {
+    if ( wire_.empty() || wire_.front().first > now ) {
+      return {};
+    }
+    auto msg = std::move( wire_.front().second );
+    wire_.pop();
+    return msg;
+  }
+
+  uint64_t queue_drops() const { return queue_drops_; }
+
+private:
+  Config config_;
+  std::default_random_engine rand_ { get_random_engine() };
+  std::deque<TCPSenderMessage> queue_ {};
+  std::queue<std::pair<uint64_t, TCPSenderMessage>> wire_ {};
+  uint64_t credit_ {};
+  uint64_t queue_drops_ {};
+};
+
+// The application writes `size` random bytes, which the TCPSender sends through the bottleneck to a TCPReceiver.
+// ACKs come back after the same delay. The transfer must deliver the data intact, and meet the given limits.
+struct TransferThroughBottleneck : public Action<SenderAndOutput>
+{
+  static constexpr uint64_t TIME_LIMIT_MS = 60000;
+
+  Bottleneck::Config link_;
+  uint64_t size_;
+  std::optional<uint64_t> max_elapsed_ms_ {};
+  std::optional<uint64_t> min_queue_drops_ {};
+  std::optional<uint64_t> max_queue_drops_ {};
+  std::optional<uint64_t> min_peak_window_ {};
+
+  TransferThroughBottleneck( const Bottleneck::Config& link, uint64_t size ) : link_( link ), size_( size ) {}
+
+  TransferThroughBottleneck& within_ms( uint64_t ms )
+  {
+    max_elapsed_ms_ = ms;
+    return *this;
+  }
+
+  TransferThroughBottleneck& with_queue_drops_at_least( uint64_t drops )
+  {
+    min_queue_drops_ = drops;
+    return *this;
+  }
+
+  TransferThroughBottleneck& with_queue_drops_at_most( uint64_t drops )
+  {
+    max_queue_drops_ = drops;
+    return *this;
+  }
+
+  TransferThroughBottleneck& with_peak_window_at_least( uint64_t window )
+  {
+    min_peak_window_ = window;
+    return *this;
+  }
+
+  std::string description() const override
+  {
+    std::ostringstream desc;
+    desc << "send " << size_ << " bytes through a " << link_.bytes_per_ms << " bytes/ms link (" << link_.delay_ms
+         << " ms each way, a queue of " << link_.queue_limit << " segments";
+    if ( link_.loss_rate ) {
+      desc << ", " << link_.loss_rate << "/65536 random loss";
+    }
+    desc << ")";
+    if ( max_elapsed_ms_.has_value() ) {
+      desc << " within " << max_elapsed_ms_.value() << " ms";
+    }
+    if ( min_queue_drops_.has_value() ) {
+      desc << ", overflowing the queue at least " << min_queue_drops_.value() << " times";
+    }
+    if ( max_queue_drops_.has_value() ) {
+      desc << ", overflowing the queue at most " << max_queue_drops_.value() << " times";
+    }
+    if ( min_peak_window_.has_value() ) {
+      desc << ", with the congestion window reaching " << min_peak_window_.value();
+    }
+    return desc.str();
+  }
+
+  void execute( SenderAndOutput& ss ) const override
+  {
+    TCPSender& sender = ss.sender;
+    TCPReceiver receiver { Reassembler { ByteStream { TCPConfig::DEFAULT_CAPACITY } } };
+    Bottleneck link { link_ };
+    std::queue<std::pair<uint64_t, TCPReceiverMessage>> acks;
+    const auto transmit = [&]( const TCPSenderMessage& msg ) { link.send( msg ); };
+
+    std::string data( size_, 0 );
+    std::default_random_engine rd { get_random_engine() };
+    for ( auto& c : data ) {
+      c = static_cast<char>( rd() );
+    }
+
+    std::string received;
+    uint64_t written = 0;
+    uint64_t now = 0;
+    uint64_t peak_window = 0;
+    while ( !receiver.reader().is_finished() ) {
+      if ( ++now > TIME_LIMIT_MS ) {
+        throw ExpectationViolation( "did not finish the transfer in " + std::to_string( TIME_LIMIT_MS ) + " ms" );
+      }
+
+      // The application keeps the outbound stream full.
+      if ( written < data.size() ) {
+        const uint64_t len = std::min( sender.writer().available_capacity(), data.size() - written );
+        sender.writer().push( data.substr( written, len ) );
+        written += len;
+        if ( written == data.size() ) {
+          sender.writer().close();
+        }
+      }
+
+      sender.tick( 1, transmit );
+      sender.push( transmit );
+      link.tick( now );
+
+      while ( auto msg = link.arrival( now ) ) {
+        receiver.receive( std::move( *msg ) );
+        acks.emplace( now + link_.delay_ms, receiver.send() );
+      }
+      while ( receiver.reader().bytes_buffered() ) {
+        received += receiver.reader().peek();
+        receiver.reader().pop( receiver.reader().peek().size() );
+      }
+
+      while ( !acks.empty() && acks.front().first <= now ) {
+        sender.receive( acks.front().second );
+        acks.pop();
+        peak_window = std::max( peak_window, sender.congestion_window() );
+      }
+      sender.push( transmit );
+    }
+
+    if ( received != data ) {
+      throw ExpectationViolation( "corrupted the data in transit" );
+    }
+    if ( max_elapsed_ms_.has_value() and now > max_elapsed_ms_.value() ) {
+      throw ExpectationViolation( "took " + std::to_string( now ) + " ms to finish the transfer" );
+    }
+    const uint64_t drops = link.queue_drops();
+    if ( ( min_queue_drops_.has_value() and drops < min_queue_drops_.value() )
+         or ( max_queue_drops_.has_value() and drops > max_queue_drops_.value() ) ) {
+      throw ExpectationViolation( "overflowed the queue " + std::to_string( drops ) + " times" );
+    }
+    if ( min_peak_window_.has_value() and peak_window < min_peak_window_.value() ) {
+      throw ExpectationViolation( "grew its congestion window only to " + std::to_string( peak_window ) );
+    }
+  }
+
+  constexpr std::string obj() const override { return "TCPSender"; }
+};
@@ -0,0 +1,113 @@
+#include "buffer_pool.hh"
+#include "byte_stream.hh"
+
+#include <exception>
+#include <iostream>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Freed blocks are reused by later allocations of the same size class, without new memory from the heap.
+void reuse_test()
+{
+  vector<void*> blocks;
+  for ( size_t i = 0; i < 100; i++ ) {
+    blocks.push_back( BufferPool::allocate( 1000 ) );
+  }
+  for ( auto* block : blocks ) {
+    BufferPool::deallocate( block, 1000 );
+  }
+
+  const auto before = BufferPool::stats();
+  for ( auto*& block : blocks ) {
+    block = BufferPool::allocate( 1024 ); // same size class as 1000 bytes
+  }
+  for ( auto* block : blocks ) {
+    BufferPool::deallocate( block, 1024 );
+  }
+  const auto after = BufferPool::stats();
+
+  if ( after.misses != before.misses || after.hits - before.hits != 100 ) {
+    throw runtime_error( "reallocating freed blocks should only produce hits" );
+  }
+  if ( after.pool_bytes != before.pool_bytes || after.high_water_bytes < after.pool_bytes ) {
+    throw runtime_error( "pool should not grow when reusing blocks" );
+  }
+}
+
+// Oversized requests bypass the pool, and count as misses.
+void oversized_test()
+{
+  const auto before = BufferPool::stats();
+  void* big = BufferPool::allocate( BufferPool::MAX_BLOCK_SIZE + 1 );
+  BufferPool::deallocate( big, BufferPool::MAX_BLOCK_SIZE + 1 );
+  const auto after = BufferPool::stats();
+  if ( after.misses != before.misses + 1 || after.pool_bytes != before.pool_bytes ) {
+    throw runtime_error( "oversized allocation should be a miss that bypasses the pool" );
+  }
+}
+
+// Slabs go back to the heap once all their blocks are free, so a burst does not hold memory forever.
+void release_test()
+{
+  const auto before = BufferPool::stats();
+  vector<void*> blocks;
+  for ( size_t i = 0; i < 4096; i++ ) {
+    blocks.push_back( BufferPool::allocate( 2000 ) ); // 8 MiB of 2 KiB blocks
+  }
+  const auto peak = BufferPool::stats();
+  for ( auto* block : blocks ) {
+    BufferPool::deallocate( block, 2000 );
+  }
+  const auto after = BufferPool::stats();
+
+  if ( peak.pool_bytes < before.pool_bytes + 4096 * 2048 || after.high_water_bytes < peak.pool_bytes ) {
+    throw runtime_error( "the burst should have grown the pool" );
+  }
+  if ( after.pool_bytes > before.pool_bytes + 1024 * 1024 ) {
+    throw runtime_error( "free slabs should return to the heap, beyond what the caches keep" );
+  }
+}
+
+// Blocks allocated by one thread can be freed by another, and a thread's counters survive its exit.
+void cross_thread_test()
+{
+  list<string, PoolAllocator<string>> strings;
+  const auto before = BufferPool::stats();
+  thread producer { [&] {
+    for ( size_t i = 0; i < 1000; i++ ) {
+      strings.emplace_back( "segment" );
+    }
+  } };
+  producer.join();
+  const auto after = BufferPool::stats();
+  if ( after.hits + after.misses - before.hits - before.misses < 1000 ) {
+    throw runtime_error( "exited thread's allocations should still be counted" );
+  }
+  strings.clear();
+
+  ByteStream bs { 100000 };
+  bs.writer().push( string( 50000, 'x' ) );
+  if ( bs.reader().peek().size() != 50000 ) {
+    throw runtime_error( "pool-backed ByteStream should hold its data" );
+  }
+}
+
+int main()
+{
+  try {
+    reuse_test();
+    oversized_test();
+    release_test();
+    cross_thread_test();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
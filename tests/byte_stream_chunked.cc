@@ -0,0 +1,92 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      ByteStreamTestHarness test { "peek returns whole front chunk", 15, ByteStream::Storage::Chunked };
+
+      test.execute( Push { "cat" } );
+      test.execute( Push { "tac" } );
+      test.execute( BytesBuffered { 6 } );
+      test.execute( AvailableCapacity { 9 } );
+      test.execute( PeekOnce { "cat" } );
+      test.execute( PeekRegions { { "cat", "tac" } } );
+      test.execute( Peek { "cattac" } );
+
+      test.execute( Pop { 2 } );
+      test.execute( PeekOnce { "t" } );
+      test.execute( PeekRegions { { "t", "tac" } } );
+      test.execute( BytesPopped { 2 } );
+
+      test.execute( Pop { 2 } );
+      test.execute( PeekOnce { "ac" } );
+      test.execute( BytesBuffered { 2 } );
+      test.execute( AvailableCapacity { 13 } );
+    }
+
+    {
+      ByteStreamTestHarness test { "peek_range across chunks", 20, ByteStream::Storage::Chunked };
+
+      test.execute( Push { "abc" } );
+      test.execute( Push { "defg" } );
+      test.execute( Push { "hi" } );
+      test.execute( Push { "jklm" } );
+      test.execute( PeekRange { 0, 2, { "ab" } } );
+      test.execute( PeekRange { 2, 6, { "c", "defg", "h" } } );
+      test.execute( PeekRange { 7, 100, { "hi", "jklm" } } );
+      test.execute( PeekRange { 13, 1, {} } );
+
+      // Going back to an earlier chunk, and then past popped ones
+      test.execute( PeekRange { 4, 2, { "ef" } } );
+      test.execute( Pop { 5 } );
+      test.execute( PeekRange { 0, 3, { "fg", "h" } } );
+      test.execute( PeekRange { 4, 3, { "jkl" } } );
+      test.execute( Pop { 5 } );
+      test.execute( Push { "no" } );
+      test.execute( PeekRange { 0, 10, { "klm", "no" } } );
+    }
+
+    {
+      ByteStreamTestHarness test { "push truncated to capacity", 4, ByteStream::Storage::Chunked };
+
+      test.execute( Push { "hello" } );
+      test.execute( BytesPushed { 4 } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( PeekOnce { "hell" } );
+
+      test.execute( Push { "o" } );
+      test.execute( BytesPushed { 4 } );
+
+      test.execute( Pop { 4 } );
+      test.execute( BufferEmpty { true } );
+      test.execute( Push { "o" } );
+      test.execute( PeekOnce { "o" } );
+    }
+
+    {
+      ByteStreamTestHarness test { "chunked close and finish", 10, ByteStream::Storage::Chunked };
+
+      test.execute( Push { "ab" } );
+      test.execute( Push { "" } );
+      test.execute( Push { "cde" } );
+      test.execute( Close {} );
+      test.execute( IsClosed { true } );
+      test.execute( IsFinished { false } );
+      test.execute( ReadAll { "abcde" } );
+      test.execute( IsFinished { true } );
+      test.execute( BytesPopped { 5 } );
+      test.execute( BytesPushed { 5 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+#include "byte_stream.hh"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+// One Writer thread and one Reader thread share a Concurrent ByteStream, blocking on each other as needed.
+void concurrent_test( const size_t input_len, // NOLINT(bugprone-easily-swappable-parameters)
+                      const size_t capacity,  // NOLINT(bugprone-easily-swappable-parameters)
+                      const size_t random_seed )
+{
+  const string data = [&] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  ByteStream bs { capacity, ByteStream::Storage::Concurrent };
+
+  thread writer_thread { [&] {
+    default_random_engine rd { random_seed + 1 };
+    uniform_int_distribution<size_t> write_size { 1, 2 * capacity };
+    Writer& writer = bs.writer();
+    size_t pushed = 0;
+    while ( pushed < data.size() ) {
+      writer.wait_for_capacity();
+      const size_t len = min<size_t>( { write_size( rd ), data.size() - pushed, writer.available_capacity() } );
+      writer.push( data.substr( pushed, len ) );
+      pushed += len;
+    }
+    writer.close();
+  } };
+
+  string output;
+  Reader& reader = bs.reader();
+  while ( !reader.is_finished() ) {
+    reader.wait_for_data();
+    for ( const auto region : reader.peek_regions() ) {
+      output += region;
+      reader.pop( region.size() );
+    }
+  }
+  writer_thread.join();
+
+  if ( output != data ) {
+    throw runtime_error( "Concurrent ByteStream: mismatch between data written and read (capacity="
+                         + to_string( capacity ) + ")" );
+  }
+  if ( reader.bytes_popped() != data.size() || bs.writer().bytes_pushed() != data.size() ) {
+    throw runtime_error( "Concurrent ByteStream: wrong byte counts" );
+  }
+}
+
+// A Reader blocked in wait_for_data() must wake up when the stream has an error.
+void error_wakes_reader_test()
+{
+  ByteStream bs { 16, ByteStream::Storage::Concurrent };
+  thread erring_thread { [&] { bs.set_error(); } };
+  bs.reader().wait_for_data();
+  erring_thread.join();
+  if ( !bs.has_error() ) {
+    throw runtime_error( "Concurrent ByteStream: wait_for_data() returned without data, EOF or error" );
+  }
+}
+
+int main()
+{
+  try {
+    concurrent_test( 1 << 14, 1, 3 );
+    concurrent_test( 1 << 16, 7, 5 );
+    concurrent_test( 1 << 22, 4096, 7 );
+    concurrent_test( 1 << 22, 65536, 11 );
+    error_wakes_reader_test();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+#include "byte_stream.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+
+#include <array>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+// Move data fd -> ByteStream -> fd with push_from() and pop_into(), across the end of the ring.
+void fd_round_trip_test( ByteStream::Storage storage )
+{
+  array<int, 2> in_fds {};
+  array<int, 2> out_fds {};
+  CheckSystemCall( "pipe", ::pipe( in_fds.data() ) );
+  CheckSystemCall( "pipe", ::pipe( out_fds.data() ) );
+  FileDescriptor in_read { in_fds[0] };
+  FileDescriptor in_write { in_fds[1] };
+  FileDescriptor out_read { out_fds[0] };
+  FileDescriptor out_write { out_fds[1] };
+
+  ByteStream bs { 10, storage };
+
+  in_write.write( "abcdefgh" );
+  if ( bs.writer().push_from( in_read ) != 8 || bs.reader().bytes_buffered() != 8 ) {
+    throw runtime_error( "push_from() should have read 8 bytes" );
+  }
+
+  bs.reader().pop( 5 );
+  in_write.write( "ijklmnopqrstuvwxyz" );
+  if ( bs.writer().push_from( in_read ) != 7 || bs.writer().available_capacity() != 0 ) {
+    throw runtime_error( "push_from() should have read only as much as capacity allows (7 bytes)" );
+  }
+
+  if ( bs.reader().pop_into( out_write ) != 10 || bs.reader().bytes_buffered() != 0 ) {
+    throw runtime_error( "pop_into() should have written and popped all 10 buffered bytes" );
+  }
+
+  string got;
+  out_read.read( got );
+  if ( got != "fghijklmno" ) {
+    throw runtime_error( "round trip produced \"" + got + "\" instead of \"fghijklmno\"" );
+  }
+
+  in_write.close();
+  bs.writer().push_from( in_read ); // remaining "pqrstuvwxyz"
+  bs.reader().pop( 10 );
+  bs.writer().push_from( in_read ); // last byte
+  bs.reader().pop( 1 );
+  bs.writer().push_from( in_read ); // EOF
+  if ( !in_read.eof() || bs.reader().bytes_popped() != 26 ) {
+    throw runtime_error( "push_from() should have reached EOF after 26 bytes" );
+  }
+}
+
+// Chunked storage hands a mostly-full read buffer over as the chunk, and copies short reads out of it.
+void chunked_read_sizes_test()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "pipe", ::pipe( fds.data() ) );
+  FileDescriptor read_end { fds[0] };
+  FileDescriptor write_end { fds[1] };
+
+  ByteStream bs { 100'000, ByteStream::Storage::Chunked };
+  const string large( 40'000, 'x' );
+  for ( const auto& data : { large, string { "short" }, large, string { "end" } } ) {
+    write_end.write( data );
+    if ( bs.writer().push_from( read_end ) != data.size() ) {
+      throw runtime_error( "push_from() should have read " + to_string( data.size() ) + " bytes" );
+    }
+  }
+
+  const auto regions = bs.reader().peek_regions();
+  if ( regions.size() != 4 || regions[0] != large || regions[1] != "short" || regions[2] != large
+       || regions[3] != "end" ) {
+    throw runtime_error( "push_from() should have made one chunk per read" );
+  }
+}
+
+int main()
+{
+  try {
+    fd_round_trip_test( ByteStream::Storage::Ring );
+    fd_round_trip_test( ByteStream::Storage::Chunked );
+    fd_round_trip_test( ByteStream::Storage::Concurrent );
+    chunked_read_sizes_test();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include "byte_stream_test_harness.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      ByteStreamTestHarness test { "ring peek across wraparound", 4, ByteStream::Storage::Ring };
+
+      test.execute( Push { "abc" } );
+      test.execute( Pop { 2 } );
+      test.execute( Push { "def" } );
+      test.execute( BytesBuffered { 4 } );
+      test.execute( PeekOnce { "cd" } );
+      test.execute( PeekRegions { { "cd", "ef" } } );
+      test.execute( Peek { "cdef" } );
+      test.execute( PeekRange { 1, 2, { "d", "e" } } );
+      test.execute( PeekRange { 2, 5, { "ef" } } );
+
+      test.execute( Pop { 2 } );
+      test.execute( PeekRegions { { "ef" } } );
+    }
+
+    {
+      // Pushes and pops of varying lengths walk the read and write positions around the ring many times.
+      // peek() returns everything buffered up to the end of the ring, and peek_wrapped() the rest.
+      constexpr uint64_t capacity = 7;
+      ByteStreamTestHarness test { "ring wraps around repeatedly", capacity, ByteStream::Storage::Ring };
+
+      string buffered;
+      uint64_t popped = 0;
+      char next = 'a';
+      for ( uint64_t round = 0; round < 40; round++ ) {
+        string data;
+        for ( uint64_t i = 0; i < 1 + round % 6; i++ ) {
+          data += next;
+          next = next == 'z' ? 'a' : static_cast<char>( next + 1 );
+        }
+        test.execute( Push { data } );
+        buffered += data.substr( 0, capacity - buffered.size() );
+
+        const uint64_t first = min( buffered.size(), capacity - popped % capacity );
+        test.execute( BytesBuffered { buffered.size() } );
+        test.execute( PeekOnce { buffered.substr( 0, first ) } );
+        if ( first < buffered.size() ) {
+          test.execute( PeekRegions { { buffered.substr( 0, first ), buffered.substr( first ) } } );
+        } else {
+          test.execute( PeekRegions { { buffered } } );
+        }
+
+        const uint64_t len = min<uint64_t>( 1 + round % 4, buffered.size() );
+        test.execute( Pop { len } );
+        buffered.erase( 0, len );
+        popped += len;
+        test.execute( BytesPopped { popped } );
+      }
+      test.execute( Peek { buffered } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,41 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    for ( const auto storage : { ByteStream::Storage::Ring, ByteStream::Storage::Chunked } ) {
+      ByteStreamTestHarness test { "set_capacity keeps buffered bytes", 4, storage };
+
+      test.execute( Push { "abcd" } );
+      test.execute( Pop { 3 } );
+      test.execute( Push { "ef" } );
+      test.execute( SetCapacity { 8 } );
+      test.execute( AvailableCapacity { 5 } );
+      test.execute( Peek { "def" } );
+      test.execute( Push { "ghijklm" } );
+      test.execute( BytesBuffered { 8 } );
+      test.execute( Peek { "defghijk" } );
+
+      test.execute( SetCapacity { 2 } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( Pop { 7 } );
+      test.execute( AvailableCapacity { 7 } );
+      test.execute( SetCapacity { 2 } );
+      test.execute( AvailableCapacity { 1 } );
+      test.execute( Peek { "k" } );
+      test.execute( Push { "lm" } );
+      test.execute( Peek { "kl" } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,46 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      // Popped bytes are released from the file a window behind the read position: by then, the writer may
+      // have wrapped around the full ring and reused their offsets.
+      ByteStreamTestHarness test { "spill release after the ring wraps", 16384, ByteStream::Storage::Spill, 4096 };
+
+      test.execute( Push { string( 16384, 'a' ) } );
+      test.execute( Pop { 4095 } );
+      test.execute( Push { string( 4095, 'b' ) } );
+      test.execute( Pop { 1 } );
+      test.execute( Pop { 12288 } );
+      test.execute( BytesBuffered { 4095 } );
+      test.execute( Peek { string( 4095, 'b' ) } );
+    }
+
+    {
+      ByteStreamTestHarness test { "spill peek across wraparound", 4, ByteStream::Storage::Spill };
+
+      test.execute( Push { "abc" } );
+      test.execute( Pop { 2 } );
+      test.execute( Push { "def" } );
+      test.execute( BytesBuffered { 4 } );
+      test.execute( PeekOnce { "cd" } );
+      test.execute( PeekRegions { { "cd", "ef" } } );
+      test.execute( Peek { "cdef" } );
+
+      test.execute( Pop { 2 } );
+      test.execute( PeekRegions { { "ef" } } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+#include "byte_stream.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sys/resource.h>
+
+using namespace std;
+using namespace std::chrono;
+
+// Push `input_len` bytes through a Spill ByteStream in bursts of `burst_size` bytes: the writer runs ahead
+// until `burst_size` bytes are buffered, then the reader drains the stream. Everything in the middle of a burst
+// has to go through the temporary file, while only a few `spill_window`s stay in memory.
+double spill_speed_test( fstream& debug_output,
+                         const uint64_t input_len,    // NOLINT(bugprone-easily-swappable-parameters)
+                         const uint64_t capacity,     // NOLINT(bugprone-easily-swappable-parameters)
+                         const uint64_t spill_window, // NOLINT(bugprone-easily-swappable-parameters)
+                         const uint64_t burst_size,   // NOLINT(bugprone-easily-swappable-parameters)
+                         const size_t write_size,     // NOLINT(bugprone-easily-swappable-parameters)
+                         const size_t read_size )     // NOLINT(bugprone-easily-swappable-parameters)
+{
+  // The stream's contents repeat a random pattern whose length doesn't divide any of the sizes above.
+  const string pattern = [] {
+    default_random_engine rd { 789 };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < 1048573; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+  const auto pattern_at = [&]( uint64_t index, size_t len ) {
+    string ret;
+    ret.reserve( len );
+    while ( ret.size() < len ) {
+      const size_t offset = ( index + ret.size() ) % pattern.size();
+      ret.append( pattern, offset, len - ret.size() );
+    }
+    return ret;
+  };
+
+  ByteStream bs { capacity, ByteStream::Storage::Spill, spill_window };
+  uint64_t checked = 0;
+
+  const auto start_time = steady_clock::now();
+  while ( not bs.reader().is_finished() ) {
+    // writer: run ahead by one burst
+    while ( bs.writer().bytes_pushed() < input_len and bs.reader().bytes_buffered() < burst_size ) {
+      const auto len = min<uint64_t>( write_size, input_len - bs.writer().bytes_pushed() );
+      bs.writer().push( pattern_at( bs.writer().bytes_pushed(), len ) );
+    }
+    if ( bs.writer().bytes_pushed() == input_len ) {
+      bs.writer().close();
+    }
+
+    // reader: drain, checking the data against the pattern
+    while ( bs.reader().bytes_buffered() ) {
+      const auto peeked = bs.reader().peek().substr( 0, read_size );
+      for ( size_t i = 0; i < peeked.size(); ) {
+        const size_t offset = ( checked + i ) % pattern.size();
+        const size_t len = min( peeked.size() - i, pattern.size() - offset );
+        if ( peeked.substr( i, len ) != string_view { pattern }.substr( offset, len ) ) {
+          throw runtime_error( "Mismatch between data written and read" );
+        }
+        i += len;
+      }
+      checked += peeked.size();
+      bs.reader().pop( peeked.size() );
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( checked != input_len ) {
+    throw runtime_error( "Spill ByteStream lost or duplicated data" );
+  }
+
+  rusage usage {};
+  getrusage( RUSAGE_SELF, &usage );
+
+  auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  auto bytes_per_second = static_cast<double>( input_len ) / test_duration.count();
+  auto gigabits_per_second = 8 * bytes_per_second / 1e9;
+
+  cout << "Spill ByteStream with capacity=" << capacity << ", spill_window=" << spill_window
+       << ", burst_size=" << burst_size << " moved " << input_len << " bytes at " << fixed << setprecision( 2 )
+       << gigabits_per_second << " Gbit/s (peak RSS " << usage.ru_maxrss / 1024 << " MiB).\n";
+
+  debug_output << "        Spill ByteStream throughput: " << fixed << setprecision( 2 ) << setw( 5 )
+               << gigabits_per_second << " Gbit/s\n";
+
+  if ( gigabits_per_second < 0.1 ) {
+    throw runtime_error( "Spill ByteStream did not meet minimum speed of 0.1 Gbit/s" );
+  }
+
+  return gigabits_per_second;
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  constexpr uint64_t GiB = 1UL << 30;
+  constexpr uint64_t MiB = 1UL << 20;
+  spill_speed_test( debug_output, 10 * GiB, 4 * GiB, 4 * MiB, 1 * GiB, 65536, 65536 );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -4,7 +4,9 @@
 #include "common.hh"
 #include "helpers.hh"
 
+#include <memory>
 #include <utility>
+#include <vector>
 
 static_assert( sizeof( Reader ) == sizeof( ByteStream ),
                "Please add member variables to the ByteStream base, not the ByteStream Reader." );
@@ -19,6 +21,30 @@ public:
     : TestHarness( move( test_name ), "capacity=" + std::to_string( capacity ), ByteStream { capacity } )
   {}
 
+  ByteStreamTestHarness( std::string test_name,
+                         uint64_t capacity,
+                         ByteStream::Storage storage,
+                         uint64_t spill_window = ByteStream::DEFAULT_SPILL_WINDOW )
+    : TestHarness( move( test_name ),
+                   "capacity=" + std::to_string( capacity ) + ", storage=" + storage_name( storage ),
+                   ByteStream { capacity, storage, spill_window } )
+  {}
+
+  static std::string storage_name( ByteStream::Storage storage )
+  {
+    switch ( storage ) {
+      case ByteStream::Storage::Ring:
+        return "ring";
+      case ByteStream::Storage::Chunked:
+        return "chunked";
+      case ByteStream::Storage::Concurrent:
+        return "concurrent";
+      case ByteStream::Storage::Spill:
+        return "spill";
+    }
+    return "unknown";
+  }
+
   size_t peek_size() { return object().reader().peek().size(); }
 };
 
@@ -47,6 +73,41 @@ struct SetError : public Action<ByteStream>
   void execute( ByteStream& bs ) const override { bs.set_error(); }
 };
 
+struct SetCapacity : public Action<ByteStream>
+{
+  uint64_t capacity_;
+
+  explicit SetCapacity( uint64_t capacity ) : capacity_( capacity ) {}
+  std::string description() const override { return "set_capacity( " + std::to_string( capacity_ ) + " )"; }
+  void execute( ByteStream& bs ) const override { bs.set_capacity( capacity_ ); }
+};
+
+struct SetLowWatermark : public Action<ByteStream>
+{
+  uint64_t low_watermark_;
+
+  explicit SetLowWatermark( uint64_t low_watermark ) : low_watermark_( low_watermark ) {}
+  std::string description() const override
+  {
+    return "set_low_watermark( " + std::to_string( low_watermark_ ) + " )";
+  }
+  void execute( ByteStream& bs ) const override { bs.writer().set_low_watermark( low_watermark_ ); }
+  constexpr std::string obj() const override { return "Writer"; }
+};
+
+struct SetHighWatermark : public Action<ByteStream>
+{
+  uint64_t high_watermark_;
+
+  explicit SetHighWatermark( uint64_t high_watermark ) : high_watermark_( high_watermark ) {}
+  std::string description() const override
+  {
+    return "set_high_watermark( " + std::to_string( high_watermark_ ) + " )";
+  }
+  void execute( ByteStream& bs ) const override { bs.reader().set_high_watermark( high_watermark_ ); }
+  constexpr std::string obj() const override { return "Reader"; }
+};
+
 struct Pop : public Action<ByteStream>
 {
   size_t len_;
@@ -57,6 +118,35 @@ struct Pop : public Action<ByteStream>
   constexpr std::string obj() const override { return "Reader"; }
 };
 
+// What an edge-notification callback has been called with so far, shared between the steps that watch and check
+using EdgeLog = std::shared_ptr<std::vector<bool>>;
+
+struct WatchWritable : public Action<ByteStream>
+{
+  EdgeLog log_;
+
+  explicit WatchWritable( EdgeLog log ) : log_( move( log ) ) {}
+  std::string description() const override { return "on_writable_change( log )"; }
+  void execute( ByteStream& bs ) const override
+  {
+    bs.writer().on_writable_change( [log = log_]( bool writable ) { log->push_back( writable ); } );
+  }
+  constexpr std::string obj() const override { return "Writer"; }
+};
+
+struct WatchReadable : public Action<ByteStream>
+{
+  EdgeLog log_;
+
+  explicit WatchReadable( EdgeLog log ) : log_( move( log ) ) {}
+  std::string description() const override { return "on_readable_change( log )"; }
+  void execute( ByteStream& bs ) const override
+  {
+    bs.reader().on_readable_change( [log = log_]( bool readable ) { log->push_back( readable ); } );
+  }
+  constexpr std::string obj() const override { return "Reader"; }
+};
+
 /* expectations */
 
 struct Peek : public Expectation<ByteStream>
@@ -119,6 +209,77 @@ struct PeekOnce : public Peek
   }
 };
 
+struct PeekRegions : public Expectation<ByteStream>
+{
+  std::vector<std::string> regions_;
+
+  explicit PeekRegions( std::vector<std::string> regions ) : regions_( move( regions ) ) {}
+
+  std::string description() const override
+  {
+    std::string ret = "peek_regions() gives {";
+    for ( const auto& x : regions_ ) {
+      ret += " \"" + pretty_print( x ) + "\"";
+    }
+    return ret + " }";
+  }
+
+  void execute( const ByteStream& bs ) const override
+  {
+    const auto peeked = bs.reader().peek_regions();
+    if ( peeked.size() != regions_.size() ) {
+      throw ExpectationViolation { "peek_regions() should have returned " + std::to_string( regions_.size() )
+                                   + " regions, but returned " + std::to_string( peeked.size() ) };
+    }
+    for ( size_t i = 0; i < peeked.size(); i++ ) {
+      if ( peeked[i] != regions_[i] ) {
+        throw ExpectationViolation { "region " + std::to_string( i ) + " should have been \""
+                                     + pretty_print( regions_[i] ) + "\", but was \"" + pretty_print( peeked[i] )
+                                     + "\"" };
+      }
+    }
+  }
+
+  constexpr std::string obj() const override { return "Reader"; }
+};
+
+struct PeekRange : public Expectation<ByteStream>
+{
+  uint64_t offset_, len_;
+  std::vector<std::string> regions_;
+
+  PeekRange( uint64_t offset, uint64_t len, std::vector<std::string> regions )
+    : offset_( offset ), len_( len ), regions_( move( regions ) )
+  {}
+
+  std::string description() const override
+  {
+    std::string ret = "peek_range(" + std::to_string( offset_ ) + ", " + std::to_string( len_ ) + ") gives {";
+    for ( const auto& x : regions_ ) {
+      ret += " \"" + pretty_print( x ) + "\"";
+    }
+    return ret + " }";
+  }
+
+  void execute( const ByteStream& bs ) const override
+  {
+    const auto peeked = bs.reader().peek_range( offset_, len_ );
+    if ( peeked.size() != regions_.size() ) {
+      throw ExpectationViolation { "peek_range() should have returned " + std::to_string( regions_.size() )
+                                   + " regions, but returned " + std::to_string( peeked.size() ) };
+    }
+    for ( size_t i = 0; i < peeked.size(); i++ ) {
+      if ( peeked[i] != regions_[i] ) {
+        throw ExpectationViolation { "region " + std::to_string( i ) + " should have been \""
+                                     + pretty_print( regions_[i] ) + "\", but was \"" + pretty_print( peeked[i] )
+                                     + "\"" };
+      }
+    }
+  }
+
+  constexpr std::string obj() const override { return "Reader"; }
+};
+
 struct IsClosed : public ExpectBool<ByteStream>
 {
   using ExpectBool::ExpectBool;
@@ -135,6 +296,48 @@ struct IsFinished : public ExpectBool<ByteStream>
   constexpr std::string obj() const override { return "Reader"; }
 };
 
+struct Writable : public ExpectBool<ByteStream>
+{
+  using ExpectBool::ExpectBool;
+  std::string name() const override { return "writable"; }
+  bool value( const ByteStream& bs ) const override { return bs.writer().writable(); }
+  constexpr std::string obj() const override { return "Writer"; }
+};
+
+struct Readable : public ExpectBool<ByteStream>
+{
+  using ExpectBool::ExpectBool;
+  std::string name() const override { return "readable"; }
+  bool value( const ByteStream& bs ) const override { return bs.reader().readable(); }
+  constexpr std::string obj() const override { return "Reader"; }
+};
+
+struct EdgesLogged : public Expectation<ByteStream>
+{
+  EdgeLog log_;
+  std::vector<bool> expected_;
+
+  EdgesLogged( EdgeLog log, std::vector<bool> expected ) : log_( move( log ) ), expected_( move( expected ) ) {}
+
+  static std::string to_string( const std::vector<bool>& edges )
+  {
+    std::string str = "{";
+    for ( const bool edge : edges ) {
+      str += edge ? " true" : " false";
+    }
+    return str + " }";
+  }
+
+  std::string description() const override { return "callback called with " + to_string( expected_ ); }
+  void execute( const ByteStream& ) const override
+  {
+    if ( *log_ != expected_ ) {
+      throw ExpectationViolation { "callback should have been called with " + to_string( expected_ )
+                                   + ", but was called with " + to_string( *log_ ) };
+    }
+  }
+};
+
 struct HasError : public ExpectBool<ByteStream>
 {
   using ExpectBool::ExpectBool;
@@ -0,0 +1,123 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      ByteStreamTestHarness test { "default watermarks", 4 };
+
+      test.execute( Writable { true } );
+      test.execute( Readable { false } );
+      test.execute( Push { "a" } );
+      test.execute( Readable { true } );
+      test.execute( Push { "bcd" } );
+      test.execute( Writable { false } );
+      test.execute( Pop { 1 } );
+      test.execute( Writable { true } );
+      test.execute( Close {} );
+      test.execute( Writable { false } );
+    }
+
+    {
+      ByteStreamTestHarness test { "low watermark", 10 };
+
+      test.execute( SetLowWatermark { 4 } );
+      test.execute( Writable { true } );
+      test.execute( Push { "abcdefghij" } );
+      test.execute( Writable { false } );
+      test.execute( Pop { 6 } );
+      test.execute( AvailableCapacity { 6 } );
+      test.execute( Writable { false } );
+      test.execute( Pop { 1 } );
+      test.execute( Writable { true } );
+      test.execute( SetError {} );
+      test.execute( Writable { false } );
+    }
+
+    {
+      ByteStreamTestHarness test { "high watermark", 10, ByteStream::Storage::Chunked };
+
+      test.execute( SetHighWatermark { 5 } );
+      test.execute( Push { "abc" } );
+      test.execute( Readable { false } );
+      test.execute( Push { "de" } );
+      test.execute( Readable { true } );
+      test.execute( Pop { 2 } );
+      test.execute( Readable { false } );
+      test.execute( Close {} );
+      test.execute( Readable { true } );
+      test.execute( Pop { 3 } );
+      test.execute( Readable { false } );
+      test.execute( IsFinished { true } );
+    }
+
+    {
+      ByteStreamTestHarness test { "watermarks capped to capacity", 3 };
+
+      test.execute( SetHighWatermark { 100 } );
+      test.execute( SetLowWatermark { 100 } );
+      test.execute( Push { "ab" } );
+      test.execute( Readable { false } );
+      test.execute( Writable { true } );
+      test.execute( Push { "c" } );
+      test.execute( Readable { true } );
+      test.execute( Writable { false } );
+    }
+
+    {
+      ByteStreamTestHarness test { "low watermark edges", 10 };
+      const auto edges = make_shared<vector<bool>>();
+
+      test.execute( SetLowWatermark { 4 } );
+      test.execute( WatchWritable { edges } );
+      test.execute( EdgesLogged { edges, { true } } ); // the current state, at once
+      test.execute( Push { "abcdefg" } );
+      test.execute( EdgesLogged { edges, { true, false } } );
+      test.execute( Pop { 3 } );
+      test.execute( Push { "h" } );
+      test.execute( EdgesLogged { edges, { true, false } } ); // no change, no call
+      test.execute( Pop { 2 } );
+      test.execute( EdgesLogged { edges, { true, false, true } } );
+      test.execute( SetLowWatermark { 2 } );
+      test.execute( EdgesLogged { edges, { true, false, true, false } } );
+      test.execute( SetLowWatermark { 5 } );
+      test.execute( EdgesLogged { edges, { true, false, true, false, true } } );
+      test.execute( SetCapacity { 3 } ); // the watermark is capped to the capacity
+      test.execute( EdgesLogged { edges, { true, false, true, false, true, false } } );
+      test.execute( Pop { 1 } );
+      test.execute( Close {} );
+      test.execute( EdgesLogged { edges, { true, false, true, false, true, false, true, false } } );
+    }
+
+    {
+      ByteStreamTestHarness test { "high watermark edges", 10, ByteStream::Storage::Chunked };
+      const auto edges = make_shared<vector<bool>>();
+
+      test.execute( SetHighWatermark { 5 } );
+      test.execute( WatchReadable { edges } );
+      test.execute( Push { "abc" } );
+      test.execute( EdgesLogged { edges, { false } } );
+      test.execute( Push { "defg" } );
+      test.execute( EdgesLogged { edges, { false, true } } );
+      test.execute( Pop { 3 } );
+      test.execute( EdgesLogged { edges, { false, true, false } } );
+      test.execute( Close {} );
+      test.execute( EdgesLogged { edges, { false, true, false, true } } );
+      test.execute( Pop { 4 } );
+      test.execute( EdgesLogged { edges, { false, true, false, true, false } } );
+      test.execute( IsFinished { true } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -80,6 +80,18 @@ string to_string( const TCPSenderMessage& msg )
   if ( msg.SYN ) {
     o << " +SYN";
   }
+  if ( msg.SACK_permitted ) {
+    o << " +SACK_PERMITTED";
+  }
+  if ( msg.MSS ) {
+    o << " MSS=" << *msg.MSS;
+  }
+  if ( msg.TSval ) {
+    o << " TSval=" << *msg.TSval;
+  }
+  if ( msg.window_scale ) {
+    o << " WS=" << static_cast<int>( *msg.window_scale );
+  }
   if ( not msg.payload.empty() ) {
     o << " payload=\"" << pretty_print( msg.payload ) << "\"";
   }
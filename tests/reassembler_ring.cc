@@ -0,0 +1,113 @@
+#include "byte_stream_test_harness.hh"
+#include "random.hh"
+#include "reassembler_test_harness.hh"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t NREPS = 32;
+static constexpr size_t NSEGS = 128;
+static constexpr size_t MAX_SEG_LEN = 2048;
+
+int main()
+{
+  try {
+    const auto ring = Reassembler::Engine::Ring;
+
+    {
+      ReassemblerTestHarness test { "ring holes", 65000, ring };
+
+      test.execute( Insert { "b", 1 } );
+      test.execute( Insert { "d", 3 }.is_last() );
+      test.execute( BytesPushed( 0 ) );
+      test.execute( BytesPending( 2 ) );
+
+      test.execute( Insert { "abc", 0 } );
+      test.execute( BytesPushed( 4 ) );
+      test.execute( BytesPending( 0 ) );
+      test.execute( ReadAll( "abcd" ) );
+      test.execute( IsFinished { true } );
+    }
+
+    {
+      ReassemblerTestHarness test { "ring overlapping", 1000, ring };
+
+      test.execute( Insert { "cdef", 2 } );
+      test.execute( Insert { "efgh", 4 } );
+      test.execute( BytesPending( 6 ) );
+      test.execute( Insert { "abcd", 0 } );
+      test.execute( BytesPending( 0 ) );
+      test.execute( ReadAll( "abcdefgh" ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "ring capacity and wraparound", 4, ring };
+
+      test.execute( Insert { "ab", 0 } );
+      test.execute( Insert { "def", 3 } );
+      test.execute( BytesPending( 1 ) );
+      test.execute( ReadAll( "ab" ) );
+
+      test.execute( Insert { "efg", 4 } );
+      test.execute( BytesPending( 3 ) );
+      test.execute( Insert { "c", 2 } );
+      test.execute( BytesPushed( 6 ) );
+      test.execute( ReadAll( "cdef" ) );
+
+      test.execute( Insert { "ghijkl", 6 }.is_last() );
+      test.execute( BytesPushed( 10 ) );
+      test.execute( ReadAll( "ghij" ) );
+      test.execute( IsFinished { false } );
+      test.execute( Insert { "kl", 10 }.is_last() );
+      test.execute( ReadAll( "kl" ) );
+      test.execute( IsFinished { true } );
+    }
+
+    {
+      ReassemblerTestHarness test { "ring keeps written-ahead bytes when capacity grows", 4, ring };
+
+      test.execute( Insert { "cd", 2 } );
+      test.execute( SetCapacity { 8 } );
+      test.execute( Insert { "gh", 6 } );
+      test.execute( BytesPending( 4 ) );
+      test.execute( Insert { "ab", 0 } );
+      test.execute( Insert { "ef", 4 } );
+      test.execute( ReadAll( "abcdefgh" ) );
+    }
+
+    // overlapping segments, as in reassembler_win
+    auto rd = get_random_engine();
+    for ( unsigned rep_no = 0; rep_no < NREPS; ++rep_no ) {
+      ReassemblerTestHarness sr { "ring win test " + to_string( rep_no ), NSEGS * MAX_SEG_LEN, ring };
+
+      vector<tuple<size_t, size_t>> seq_size;
+      size_t offset = 0;
+      for ( unsigned i = 0; i < NSEGS; ++i ) {
+        const size_t size = 1 + ( rd() % ( MAX_SEG_LEN - 1 ) );
+        const size_t offs = min( offset, 1 + ( static_cast<size_t>( rd() ) % 1023 ) );
+        seq_size.emplace_back( offset - offs, size + offs );
+        offset += size;
+      }
+      shuffle( seq_size.begin(), seq_size.end(), rd );
+
+      string d( offset, 0 );
+      generate( d.begin(), d.end(), [&] { return rd(); } );
+
+      for ( auto [off, sz] : seq_size ) {
+        sr.execute( Insert { d.substr( off, sz ), off }.is_last( off + sz == offset ) );
+      }
+
+      sr.execute( ReadAll { d } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+#include "byte_stream_test_harness.hh"
+#include "reassembler_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+  try {
+    for ( const auto engine : { Reassembler::Engine::IntervalMap, Reassembler::Engine::Ring } ) {
+      ReassemblerTestHarness test { "in-order fast path", 8, engine };
+
+      test.execute( Insert { "abc", 0 } );
+      test.execute( Insert { "cde", 2 } ); // overlaps what was pushed, but starts in order
+      test.execute( FastPathInserts { 2 } );
+      test.execute( SlowPathInserts { 0 } );
+      test.execute( BytesPushed( 5 ) );
+
+      test.execute( HasPending { false } );
+      test.execute( Insert { "gh", 6 } );
+      test.execute( SlowPathInserts { 1 } );
+      test.execute( BytesPending( 2 ) );
+      test.execute( HasPending { true } );
+      // in order, but the IntervalMap engine only takes the fast path when nothing is pending
+      const bool ring = engine == Reassembler::Engine::Ring;
+      test.execute( Insert { "f", 5 } );
+      test.execute( SlowPathInserts { ring ? 1U : 2U } );
+      test.execute( BytesPushed( 8 ) );
+      test.execute( BytesPending( 0 ) );
+      test.execute( HasPending { false } );
+      test.execute( ReadAll( "abcdefgh" ) );
+
+      test.execute( Insert { "h", 7 } ); // nothing new: counted as neither
+      test.execute( Insert { "ij", 8 }.is_last() );
+      test.execute( FastPathInserts { ring ? 4U : 3U } );
+      test.execute( ReadAll( "ij" ) );
+      test.execute( IsFinished { true } );
+    }
+
+    for ( const auto engine : { Reassembler::Engine::IntervalMap, Reassembler::Engine::Ring } ) {
+      ReassemblerTestHarness test { "pending ranges", 20, engine };
+
+      test.execute( PendingRanges { {} } );
+      test.execute( Insert { "cd", 2 } );
+      test.execute( Insert { "gh", 6 } );
+      test.execute( Insert { "ef", 4 } ); // touches both neighbours, so the three merge into one range
+      test.execute( Insert { "kl", 10 } );
+      test.execute( Insert { "pq", 15 } );
+      test.execute( PendingRanges { { { 2, 8 }, { 10, 12 }, { 15, 17 } } } );
+      test.execute( PendingRanges { { { 2, 8 }, { 10, 12 } }, 2 } );
+
+      test.execute( Insert { "ab", 0 } );
+      test.execute( BytesPushed( 8 ) );
+      test.execute( PendingRanges { { { 10, 12 }, { 15, 17 } } } );
+      test.execute( Insert { "ijklmnop", 8 } );
+      test.execute( PendingRanges { {} } );
+      test.execute( BytesPushed( 17 ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "farthest segments are evicted first", 100 };
+
+      test.execute( SetLimits { { .max_segments = 2 } } );
+      test.execute( Insert { "b", 1 } );
+      test.execute( Insert { "d", 3 } );
+      test.execute( Insert { "f", 5 } );
+      test.execute( SegmentsPending { 2 } );
+      test.execute( EvictedSegments { 1 } );
+      test.execute( BytesPending( 2 ) );
+
+      test.execute( Insert { "c", 2 } ); // fills a gap, so now three segments: "b", "c", "d"
+      test.execute( EvictedSegments { 2 } );
+      test.execute( Insert { "a", 0 } );
+      test.execute( ReadAll( "abc" ) );
+      test.execute( BytesPending( 0 ) );
+      test.execute( Insert { "def", 3 } );
+      test.execute( ReadAll( "def" ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "memory limit", 100 };
+
+      test.execute( Insert { "x", 10 } );
+      test.execute( Insert { "y", 20 } );
+      test.execute( Insert { "z", 30 } );
+      test.execute( SetLimits { { .max_memory_bytes = 2 * ( Reassembler::SEGMENT_METADATA_BYTES + 1 ) - 1 } } );
+      test.execute( SegmentsPending { 1 } );
+      test.execute( EvictedSegments { 2 } );
+      test.execute( BytesPending( 1 ) );
+    }
+
+    {
+      // A slice that keeps a larger buffer alive is charged for all of it
+      ReassemblerTestHarness test { "memory limit counts whole buffers", 1000 };
+
+      test.execute( Insert { "f", 5 } );
+      test.execute( Insert { "bcdefghi", 1 } ); // "bcde" shares the buffer; "ghi" is a copy
+      test.execute( SegmentsPending { 3 } );
+      test.execute( BufferBytesPending { 12 } );
+      test.execute( SetLimits { { .max_memory_bytes = 3 * Reassembler::SEGMENT_METADATA_BYTES + 12 } } );
+      test.execute( EvictedSegments { 0 } );
+      test.execute( SetLimits { { .max_memory_bytes = 3 * Reassembler::SEGMENT_METADATA_BYTES + 11 } } );
+      test.execute( SegmentsPending { 2 } );
+      test.execute( BufferBytesPending { 9 } );
+      test.execute( SetLimits { { .max_memory_bytes = Reassembler::SEGMENT_METADATA_BYTES + 8 } } );
+      test.execute( SegmentsPending { 1 } );
+      test.execute( BufferBytesPending { 8 } );
+      test.execute( BytesPending( 4 ) );
+    }
+
+    {
+      ReassemblerTestHarness test { "limits are on by default", 1 << 20 };
+
+      for ( uint64_t i = 0; i < 5000; i++ ) {
+        test.execute( Insert { "x", 2 * i + 1 } );
+      }
+      test.execute( SegmentsPending { Reassembler::Limits {}.max_segments } );
+      test.execute( EvictedSegments { 5000 - Reassembler::Limits {}.max_segments } );
+    }
+
+    {
+      ReassemblerTestHarness test { "small gap fills do not pin whole segments", 10000 };
+
+      test.execute( Insert { string( 1000, 'b' ), 10 } );
+      test.execute( BufferBytesPending { 1000 } );
+      test.execute( Insert { string( 1000, 'a' ), 9 } ); // only byte 9 is new: copied, not shared
+      test.execute( BufferBytesPending { 1001 } );
+      test.execute( Insert { string( 1500, 'c' ), 500 } ); // most of it is new: shared
+      test.execute( BufferBytesPending { 2501 } );
+      test.execute( SegmentsPending { 3 } );
+
+      test.execute( Insert { string( 9, 'x' ), 0 } );
+      test.execute( BytesPushed( 2000 ) );
+      test.execute( BufferBytesPending { 0 } );
+    }
+
+    {
+      ReassemblerTestHarness test { "a slice trimmed to the window is copied", 100 };
+
+      test.execute( Insert { string( 1000, 'z' ), 99 } );
+      test.execute( BytesPending( 1 ) );
+      test.execute( BufferBytesPending { 1 } );
+      test.execute( SetLimits { { .max_segments = 0 } } );
+      test.execute( BufferBytesPending { 0 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
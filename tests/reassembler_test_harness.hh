@@ -4,8 +4,10 @@
 #include "helpers.hh"
 #include "reassembler.hh"
 
+#include <algorithm>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 template<std::derived_from<TestStep<ByteStream>> T>
 struct ReassemblerTestStep : public TestStep<Reassembler>
@@ -31,6 +33,23 @@ public:
                    { Reassembler { ByteStream { capacity } } } )
   {}
 
+  ReassemblerTestHarness( std::string test_name, uint64_t capacity, Reassembler::Engine engine )
+    : TestHarness( move( test_name ),
+                   "capacity=" + std::to_string( capacity ) + ", engine=" + engine_name( engine ),
+                   { Reassembler { ByteStream { capacity }, engine } } )
+  {}
+
+  static std::string engine_name( Reassembler::Engine engine )
+  {
+    switch ( engine ) {
+      case Reassembler::Engine::IntervalMap:
+        return "interval map";
+      case Reassembler::Engine::Ring:
+        return "ring";
+    }
+    return "unknown";
+  }
+
   template<std::derived_from<TestStep<ByteStream>> T>
   void execute( const T& test )
   {
@@ -47,6 +66,96 @@ struct BytesPending : public ExpectNumber<Reassembler, uint64_t>
   uint64_t value( const Reassembler& r ) const override { return r.count_bytes_pending(); }
 };
 
+struct HasPending : public ExpectBool<Reassembler>
+{
+  using ExpectBool::ExpectBool;
+  std::string name() const override { return "has_pending"; }
+  bool value( const Reassembler& r ) const override { return r.has_pending(); }
+};
+
+struct FastPathInserts : public ExpectNumber<Reassembler, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "stats().fast_path_inserts"; }
+  uint64_t value( const Reassembler& r ) const override { return r.stats().fast_path_inserts; }
+};
+
+struct SlowPathInserts : public ExpectNumber<Reassembler, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "stats().slow_path_inserts"; }
+  uint64_t value( const Reassembler& r ) const override { return r.stats().slow_path_inserts; }
+};
+
+struct SetLimits : public Action<Reassembler>
+{
+  Reassembler::Limits limits_;
+
+  explicit SetLimits( Reassembler::Limits limits ) : limits_( limits ) {}
+  std::string description() const override
+  {
+    return "set limits to " + std::to_string( limits_.max_segments ) + " segments and "
+           + std::to_string( limits_.max_memory_bytes ) + " bytes of memory";
+  }
+  void execute( Reassembler& r ) const override { r.set_limits( limits_ ); }
+};
+
+struct BufferBytesPending : public ExpectNumber<Reassembler, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "buffer_bytes_pending"; }
+  uint64_t value( const Reassembler& r ) const override { return r.buffer_bytes_pending(); }
+};
+
+struct SegmentsPending : public ExpectNumber<Reassembler, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "segments_pending"; }
+  uint64_t value( const Reassembler& r ) const override { return r.segments_pending(); }
+};
+
+struct EvictedSegments : public ExpectNumber<Reassembler, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "stats().evicted_segments"; }
+  uint64_t value( const Reassembler& r ) const override { return r.stats().evicted_segments; }
+};
+
+struct PendingRanges : public Expectation<Reassembler>
+{
+  std::vector<Reassembler::ByteRange> ranges_;
+  size_t max_ranges_;
+
+  explicit PendingRanges( std::vector<Reassembler::ByteRange> ranges, size_t max_ranges = SIZE_MAX )
+    : ranges_( std::move( ranges ) ), max_ranges_( max_ranges )
+  {}
+
+  static std::string describe( const std::vector<Reassembler::ByteRange>& ranges )
+  {
+    std::ostringstream ss;
+    ss << "{";
+    for ( const auto& range : ranges ) {
+      ss << " [" << range.first << ", " << range.last << ")";
+    }
+    ss << " }";
+    return ss.str();
+  }
+
+  std::string description() const override { return "pending_ranges() gives " + describe( ranges_ ); }
+
+  void execute( const Reassembler& r ) const override
+  {
+    const auto got = r.pending_ranges( max_ranges_ );
+    const bool same = std::ranges::equal( got, ranges_, []( const auto& a, const auto& b ) {
+      return a.first == b.first && a.last == b.last;
+    } );
+    if ( !same ) {
+      throw ExpectationViolation { "pending_ranges() should have given " + describe( ranges_ ) + ", but gave "
+                                   + describe( got ) };
+    }
+  }
+};
+
 struct Insert : public Action<Reassembler>
 {
   std::string data_;
@@ -4,9 +4,11 @@
 #include "tcp_receiver.hh"
 #include "tcp_receiver_message.hh"
 
+#include <algorithm>
 #include <optional>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 template<std::derived_from<TestStep<Reassembler>> T>
 struct DirectReassemblerTest : public TestStep<TCPReceiver>
@@ -58,11 +60,11 @@ public:
   using TestHarness<TCPReceiver>::execute;
 };
 
-struct ExpectWindow : public ExpectNumber<TCPReceiver, uint16_t>
+struct ExpectWindow : public ExpectNumber<TCPReceiver, uint32_t>
 {
   using ExpectNumber::ExpectNumber;
   std::string name() const override { return "window_size"; }
-  uint16_t value( const TCPReceiver& rs ) const override { return rs.send().window_size; }
+  uint32_t value( const TCPReceiver& rs ) const override { return rs.send().window_size; }
 };
 
 struct ExpectAckno : public ExpectNumber<TCPReceiver, std::optional<Wrap32>>
@@ -115,6 +117,102 @@ struct HasAckno : public ExpectBool<TCPReceiver>
   bool value( const TCPReceiver& rs ) const override { return rs.send().ackno.has_value(); }
 };
 
+struct EnableAutotuning : public Action<TCPReceiver>
+{
+  uint64_t max_capacity_;
+
+  explicit EnableAutotuning( uint64_t max_capacity ) : max_capacity_( max_capacity ) {}
+  std::string description() const override
+  {
+    return "enable autotuning up to " + std::to_string( max_capacity_ ) + " bytes";
+  }
+  void execute( TCPReceiver& rs ) const override { rs.enable_autotuning( max_capacity_ ); }
+};
+
+struct EnableWindowScale : public Action<TCPReceiver>
+{
+  uint8_t shift_;
+
+  explicit EnableWindowScale( uint8_t shift ) : shift_( shift ) {}
+  std::string description() const override { return "enable window scale shift " + std::to_string( shift_ ); }
+  void execute( TCPReceiver& rs ) const override { rs.enable_window_scale( shift_ ); }
+};
+
+struct ExpectWindowScale : public ExpectNumber<TCPReceiver, uint8_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "window_scale"; }
+  uint8_t value( const TCPReceiver& rs ) const override { return rs.window_scale(); }
+};
+
+struct EnableTimestamps : public Action<TCPReceiver>
+{
+  std::string description() const override { return "enable timestamps"; }
+  void execute( TCPReceiver& rs ) const override { rs.enable_timestamps(); }
+};
+
+struct ExpectTSecr : public ExpectNumber<TCPReceiver, std::optional<uint32_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "TSecr"; }
+  std::optional<uint32_t> value( const TCPReceiver& rs ) const override { return rs.send().TSecr; }
+};
+
+struct ExpectPAWSRejected : public ExpectNumber<TCPReceiver, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "paws_rejected"; }
+  uint64_t value( const TCPReceiver& rs ) const override { return rs.paws_rejected(); }
+};
+
+struct Tick : public Action<TCPReceiver>
+{
+  uint64_t ms_;
+
+  explicit Tick( uint64_t ms ) : ms_( ms ) {}
+  std::string description() const override { return std::to_string( ms_ ) + " ms pass"; }
+  void execute( TCPReceiver& rs ) const override { rs.tick( ms_ ); }
+};
+
+struct ExpectRTTEstimate : public ExpectNumber<TCPReceiver, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "rtt_estimate"; }
+  uint64_t value( const TCPReceiver& rs ) const override { return rs.rtt_estimate(); }
+};
+
+struct ExpectSACK : public Expectation<TCPReceiver>
+{
+  std::vector<SACKBlock> blocks_;
+
+  explicit ExpectSACK( std::vector<SACKBlock> blocks ) : blocks_( std::move( blocks ) ) {}
+
+  static std::string describe( const std::vector<SACKBlock>& blocks )
+  {
+    std::ostringstream ss;
+    ss << "{";
+    for ( const auto& block : blocks ) {
+      ss << " [" << block.left << ", " << block.right << ")";
+    }
+    ss << " }";
+    return ss.str();
+  }
+
+  std::string description() const override { return "receiver reports SACK blocks " + describe( blocks_ ); }
+
+  void execute( const TCPReceiver& rs ) const override
+  {
+    const auto got = rs.send().sack;
+    const bool same = std::ranges::equal( got, blocks_, []( const auto& a, const auto& b ) {
+      return a.left == b.left && a.right == b.right;
+    } );
+    if ( !same ) {
+      throw ExpectationViolation { "receiver should have reported SACK blocks " + describe( blocks_ )
+                                   + ", but reported " + describe( got ) };
+    }
+  }
+};
+
 struct SegmentArrives : public Action<TCPReceiver>
 {
   TCPSenderMessage msg_ {};
@@ -132,6 +230,24 @@ struct SegmentArrives : public Action<TCPReceiver>
     return *this;
   }
 
+  SegmentArrives& with_sack_permitted()
+  {
+    msg_.SACK_permitted = true;
+    return *this;
+  }
+
+  SegmentArrives& with_window_scale( uint8_t shift )
+  {
+    msg_.window_scale = shift;
+    return *this;
+  }
+
+  SegmentArrives& with_tsval( uint32_t tsval )
+  {
+    msg_.TSval = tsval;
+    return *this;
+  }
+
   SegmentArrives& with_rst()
   {
     msg_.RST = true;
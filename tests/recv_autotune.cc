@@ -0,0 +1,88 @@
+#include "byte_stream_test_harness.hh"
+#include "receiver_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      const uint32_t isn = 3455;
+      TCPReceiverTestHarness test { "capacity follows the application's drain rate", 1000 };
+      test.execute( EnableAutotuning { 3000 } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectWindow { 1000 } );
+
+      // The first window of data starts the RTT measurement.
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 1000, 'a' ) ) );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( ExpectRTTEstimate { 0 } );
+      test.execute( Pop { 1000 } );
+      test.execute( Tick { 10 } );
+
+      // The next one arrives a round trip later: the application drained 1000 bytes, so the capacity doubles.
+      test.execute( SegmentArrives {}.with_seqno( isn + 1001 ).with_data( string( 1000, 'b' ) ) );
+      test.execute( ExpectRTTEstimate { 10 } );
+      test.execute( ExpectWindow { 1000 } );
+      test.execute( Pop { 1000 } );
+      test.execute( Tick { 10 } );
+
+      // Draining no faster than before does not grow the capacity.
+      test.execute( SegmentArrives {}.with_seqno( isn + 2001 ).with_data( string( 2000, 'c' ) ) );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 2000 } );
+      test.execute( Tick { 10 } );
+
+      // Draining faster grows it again, but only up to the ceiling.
+      test.execute( SegmentArrives {}.with_seqno( isn + 4001 ).with_data( string( 2000, 'd' ) ) );
+      test.execute( ExpectWindow { 1000 } );
+      test.execute( BytesPopped { 4000 } );
+
+      // Idle connections shrink back to the original capacity once the buffer is empty, but without
+      // retracting the window already offered: the right edge stays put while the application catches up.
+      test.execute( Pop { 2000 } );
+      test.execute( ExpectWindow { 3000 } );
+      test.execute( Tick { TCPReceiver::AUTOTUNE_IDLE_MS - 1 } );
+      test.execute( ExpectWindow { 3000 } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectWindow { 3000 } );
+
+      test.execute( SegmentArrives {}.with_seqno( isn + 6001 ).with_data( string( 2000, 'e' ) ) );
+      test.execute( ExpectWindow { 1000 } );
+      test.execute( Pop { 1500 } );
+      test.execute( ExpectWindow { 1000 } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectWindow { 1000 } );
+      test.execute( Pop { 500 } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectWindow { 1000 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 8001 ).with_data( string( 1000, 'f' ) ) );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 1000 } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectWindow { 1000 } );
+    }
+
+    {
+      const uint32_t isn = 98;
+      TCPReceiverTestHarness test { "no autotuning unless enabled", 1000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 1000, 'a' ) ) );
+      test.execute( Pop { 1000 } );
+      test.execute( Tick { 10 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1001 ).with_data( string( 1000, 'b' ) ) );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( ExpectRTTEstimate { 0 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
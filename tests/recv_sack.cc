@@ -0,0 +1,70 @@
+#include "byte_stream_test_harness.hh"
+#include "random.hh"
+#include "reassembler_test_harness.hh"
+#include "receiver_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "SACK blocks describe out-of-order data", 100 };
+      test.execute( SegmentArrives {}.with_syn().with_sack_permitted().with_seqno( isn ) );
+      test.execute( ExpectSACK { {} } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "efgh" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 1 } } );
+      test.execute( ExpectSACK { { { Wrap32 { isn + 5 }, Wrap32 { isn + 9 } } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 12 ).with_data( "lm" ) );
+      test.execute( ExpectSACK {
+        { { Wrap32 { isn + 12 }, Wrap32 { isn + 14 } }, { Wrap32 { isn + 5 }, Wrap32 { isn + 9 } } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 9 ).with_data( "ij" ) );
+      test.execute( ExpectSACK {
+        { { Wrap32 { isn + 5 }, Wrap32 { isn + 11 } }, { Wrap32 { isn + 12 }, Wrap32 { isn + 14 } } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abcd" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 11 } } );
+      test.execute( ExpectSACK { { { Wrap32 { isn + 12 }, Wrap32 { isn + 14 } } } } );
+      test.execute( ReadAll( "abcdefghij" ) );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "at most MAX_SACK_BLOCKS blocks, latest first, then nearest", 100 };
+      test.execute( SegmentArrives {}.with_syn().with_sack_permitted().with_seqno( isn ) );
+      for ( uint32_t i = 0; i < 6; i++ ) {
+        test.execute( SegmentArrives {}.with_seqno( isn + 3 + 2 * i ).with_data( "x" ) );
+      }
+      test.execute( ExpectSACK { { { Wrap32 { isn + 13 }, Wrap32 { isn + 14 } },
+                                   { Wrap32 { isn + 3 }, Wrap32 { isn + 4 } },
+                                   { Wrap32 { isn + 5 }, Wrap32 { isn + 6 } },
+                                   { Wrap32 { isn + 7 }, Wrap32 { isn + 8 } } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 7 ).with_data( "x" ) );
+      test.execute( ExpectSACK { { { Wrap32 { isn + 7 }, Wrap32 { isn + 8 } },
+                                   { Wrap32 { isn + 3 }, Wrap32 { isn + 4 } },
+                                   { Wrap32 { isn + 5 }, Wrap32 { isn + 6 } },
+                                   { Wrap32 { isn + 9 }, Wrap32 { isn + 10 } } } } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "no SACK blocks unless the SYN permitted them", 100 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "efgh" ) );
+      test.execute( BytesPending { 4 } );
+      test.execute( ExpectSACK { {} } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
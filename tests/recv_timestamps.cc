@@ -0,0 +1,80 @@
+#include "byte_stream_test_harness.hh"
+#include "random.hh"
+#include "receiver_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "TS.Recent follows the in-order segments", 1000 };
+      test.execute( EnableTimestamps {} );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_tsval( 100 ) );
+      test.execute( ExpectTSecr { 100 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ).with_tsval( 200 ) );
+      test.execute( ExpectTSecr { 200 } );
+
+      // PAWS: an older TSval marks an old duplicate
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "old" ).with_tsval( 150 ) );
+      test.execute( ExpectPAWSRejected { 1 } );
+      test.execute( BytesPushed { 3 } );
+
+      // A segment past a hole is not the one the next ACK answers
+      test.execute( SegmentArrives {}.with_seqno( isn + 7 ).with_data( "ghi" ).with_tsval( 300 ) );
+      test.execute( ExpectTSecr { 200 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "def" ).with_tsval( 250 ) );
+      test.execute( ExpectTSecr { 250 } );
+      test.execute( BytesPushed { 9 } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "a segment outside the window leaves TS.Recent alone", 10 };
+      test.execute( EnableTimestamps {} );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_tsval( 100 ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ).with_tsval( 200 ) );
+      test.execute( ExpectTSecr { 200 } );
+
+      // Entirely old data, acknowledged already: not acceptable, however new its TSval
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ).with_tsval( 500 ) );
+      test.execute( ExpectTSecr { 200 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "def" ).with_tsval( 300 ) );
+      test.execute( ExpectPAWSRejected { 0 } );
+      test.execute( BytesPushed { 6 } );
+      test.execute( ExpectTSecr { 300 } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "timestamps compare modulo 2^32", 1000 };
+      test.execute( EnableTimestamps {} );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_tsval( 0xFFFF'FFF0 ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "a" ).with_tsval( 5 ) );
+      test.execute( ExpectPAWSRejected { 0 } );
+      test.execute( ExpectTSecr { 5 } );
+    }
+
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "no echo unless the peer's SYN carried a timestamp", 1000 };
+      test.execute( EnableTimestamps {} );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectTSecr { nullopt } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -106,6 +106,26 @@ int main()
       test.execute( BytesPending( 0 ) );
     }
 
+    {
+      const size_t cap = 1'000'001;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "scaled window is rounded down to the scale", cap };
+      test.execute( EnableWindowScale { 5 } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 0 ) );
+      test.execute( ExpectWindowScale { 5 } );
+      test.execute( ExpectWindow { 1'000'000 } );
+    }
+
+    {
+      const size_t cap = 1'000'001;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "no window scaling unless the peer offered it", cap };
+      test.execute( EnableWindowScale { 5 } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectWindowScale { 0 } );
+      test.execute( ExpectWindow { UINT16_MAX } );
+    }
+
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return 1;
@@ -0,0 +1,158 @@
+#include "bottleneck.hh"
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    constexpr uint64_t mss = TCPConfig::MAX_PAYLOAD_SIZE;
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "NewReno: slow start, fast recovery, congestion avoidance, RTO", cfg };
+      test.execute( SetCongestionControl { CongestionControl::Algorithm::NewReno } );
+      test.execute( EnableFastRetransmit {} );
+      test.execute( ExpectCongestionWindow { 10 * mss } ); // RFC 6928 initial window
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 60'000 ) );
+
+      // Slow start doubles the window per round trip (the SYN's sequence number counts too)
+      test.execute( Push { string( 10 * mss, 'x' ) } );
+      test.execute( ExpectSeqnosInFlight { 10 * mss } );
+      test.execute( AckReceived { isn + 1 + 10 * mss }.with_win( 60'000 ) );
+      test.execute( ExpectCongestionWindow { 20 * mss + 1 } );
+
+      // The first segment of the next flight is lost: the third duplicate ACK halves the window
+      test.execute( Push { string( 20 * mss, 'x' ) } );
+      test.execute( ExpectSeqnosInFlight { 20 * mss } );
+      test.execute( AckReceived { isn + 1 + 10 * mss }.with_win( 60'000 ) );
+      test.execute( AckReceived { isn + 1 + 10 * mss }.with_win( 60'000 ) );
+      test.execute( ExpectCongestionWindow { 20 * mss + 1 } );
+      test.execute( AckReceived { isn + 1 + 10 * mss }.with_win( 60'000 ) );
+      test.execute( ExpectCongestionWindow { 10 * mss } );
+
+      // ... and holds it through fast recovery
+      test.execute( AckReceived { isn + 1 + 10 * mss }.with_win( 60'000 ) );
+      test.execute( ExpectCongestionWindow { 10 * mss } );
+      test.execute( AckReceived { isn + 1 + 30 * mss }.with_win( 60'000 ) );
+      test.execute( ExpectCongestionWindow { 10 * mss } );
+
+      // Congestion avoidance adds a segment per round trip
+      test.execute( Push { string( 10 * mss, 'x' ) } );
+      test.execute( AckReceived { isn + 1 + 40 * mss }.with_win( 60'000 ) );
+      test.execute( ExpectCongestionWindow { 11 * mss } );
+
+      // The retransmission timer drops the window to one segment
+      test.execute( Push { string( 5 * mss, 'x' ) } );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectCongestionWindow { mss } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 5000;
+
+      TCPSenderTestHarness test { "CUBIC: multiplicative decrease to 70%, slow return to W_max", cfg };
+      test.execute( SetCongestionControl { CongestionControl::Algorithm::Cubic } );
+      test.execute( EnableFastRetransmit {} );
+      test.execute( Push {} );
+      test.execute( AckReceived { isn + 1 }.with_win( 60'000 ) );
+
+      // Slow start grows the window by the bytes acknowledged
+      test.execute( Push { string( 10 * mss, 'x' ) } );
+      test.execute( AckReceived { isn + 1 + 10 * mss }.with_win( 60'000 ) );
+      test.execute( ExpectCongestionWindow { 20 * mss + 1 } );
+
+      test.execute( Push { string( 20 * mss, 'x' ) } );
+      for ( int i = 0; i < 3; i++ ) {
+        test.execute( AckReceived { isn + 1 + 10 * mss }.with_win( 60'000 ) );
+      }
+      test.execute( ExpectCongestionWindow { 14 * mss } );
+      test.execute( AckReceived { isn + 1 + 30 * mss }.with_win( 60'000 ) );
+
+      // The window climbs back towards W_max (20 segments), slowest near it: it takes K = 2.5 s to get there,
+      // so a flight acknowledged a second later still leaves it short.
+      test.execute( Push { string( 14 * mss, 'x' ) } );
+      test.execute( Tick { 1000 } );
+      test.execute( AckReceived { isn + 1 + 44 * mss }.with_win( 60'000 ) );
+      test.execute( ExpectCongestionWindow { 19'609 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "BBR: the RTO drops the window to one segment", cfg };
+      test.execute( SetCongestionControl { CongestionControl::Algorithm::BBR } );
+      test.execute( ExpectCongestionWindow { 10 * mss } );
+      test.execute( Push {} );
+      test.execute( AckReceived { isn + 1 }.with_win( 60'000 ) );
+      test.execute( Push { string( 5 * mss, 'x' ) } );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectCongestionWindow { mss } );
+    }
+
+    // 1 MSS per ms, 20 ms RTT: the bandwidth-delay product is 20 segments, and the queue holds 30 more.
+    // The receive window (64 segments) is bigger than that, so without congestion control the queue overflows.
+    const Bottleneck::Config link { .bytes_per_ms = 1000, .delay_ms = 10, .queue_limit = 30, .loss_rate = 0 };
+    Bottleneck::Config lossy_link = link;
+    lossy_link.loss_rate = 200; // about 0.3%
+
+    {
+      TCPConfig cfg;
+      cfg.rt_timeout = 100;
+
+      TCPSenderTestHarness test { "without congestion control, the queue overflows", cfg };
+      test.execute( EnableSACK {} );
+      test.execute( EnableFastRetransmit {} );
+      test.execute( TransferThroughBottleneck { link, 1'000'000 }.with_queue_drops_at_least( 300 ) );
+    }
+
+    for ( const auto algorithm : { CongestionControl::Algorithm::NewReno,
+                                   CongestionControl::Algorithm::Cubic,
+                                   CongestionControl::Algorithm::BBR } ) {
+      for ( const auto& [lossy, path] : { pair { false, link }, pair { true, lossy_link } } ) {
+        TCPConfig cfg;
+        cfg.rt_timeout = 100;
+
+        TCPSenderTestHarness test { string { CongestionControl::name( algorithm ) }
+                                      + ( lossy ? " keeps the transfer going under random loss"
+                                                : " uses the link without overflowing the queue" ),
+                                    cfg };
+        test.execute( EnableSACK {} );
+        test.execute( EnableFastRetransmit {} );
+        test.execute( SetCongestionControl { algorithm } );
+        if ( lossy ) {
+          test.execute( TransferThroughBottleneck { path, 1'000'000 }.within_ms( 10000 ) );
+        } else {
+          // at least a third of the link, and a window grown to the bandwidth-delay product
+          test.execute( TransferThroughBottleneck { path, 1'000'000 }
+                          .within_ms( 3000 )
+                          .with_queue_drops_at_most( 100 )
+                          .with_peak_window_at_least( 20 * mss ) );
+        }
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
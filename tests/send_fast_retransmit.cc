@@ -0,0 +1,156 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    for ( const bool enabled : { true, false } ) {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 10000;
+
+      TCPSenderTestHarness test { enabled ? "third duplicate ACK retransmits" : "duplicate ACKs ignored by default",
+                                  cfg };
+      if ( enabled ) {
+        test.execute( EnableFastRetransmit {} );
+      }
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      for ( const string data : { "abc", "def", "ghi", "jkl", "mno" } ) {
+        test.execute( Push( data ) );
+        test.execute( ExpectMessage {}.with_data( data ) );
+      }
+
+      // "abc" is lost; each later segment that arrives makes the peer repeat its ACK.
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      if ( enabled ) {
+        test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+        test.execute( ExpectConsecutiveRetransmissions { 0 } );
+      }
+      test.execute( ExpectNoSegment {} );
+
+      // More duplicates during recovery do not retransmit again.
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 15 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 10000;
+
+      TCPSenderTestHarness test { "partial ACK retransmits the next hole", cfg };
+      test.execute( EnableFastRetransmit {} );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      for ( const string data : { "abc", "def", "ghi", "jkl", "mno" } ) {
+        test.execute( Push( data ) );
+        test.execute( ExpectMessage {}.with_data( data ) );
+      }
+
+      // "abc" and "ghi" are both lost.
+      for ( int i = 0; i < 3; i++ ) {
+        test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      }
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+
+      // The retransmission fills the first hole; the ACK stops short of everything sent, so resend at once.
+      test.execute( AckReceived { Wrap32 { isn + 7 } }.with_win( 1000 ) );
+      test.execute( ExpectMessage {}.with_data( "ghi" ).with_seqno( isn + 7 ) );
+      test.execute( ExpectNoSegment {} );
+
+      // An ACK for everything sent when recovery began ends it: new duplicates start a fresh count.
+      test.execute( Push( "pqr" ) );
+      test.execute( ExpectMessage {}.with_data( "pqr" ) );
+      test.execute( AckReceived { Wrap32 { isn + 16 } }.with_win( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 16 } }.with_win( 1000 ) );
+      test.execute( AckReceived { Wrap32 { isn + 16 } }.with_win( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 16 } }.with_win( 1000 ) );
+      test.execute( ExpectMessage {}.with_data( "pqr" ).with_seqno( isn + 16 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 10000;
+
+      TCPSenderTestHarness test { "a changed window is not a duplicate ACK", cfg };
+      test.execute( EnableFastRetransmit {} );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      for ( const uint16_t window : { 999, 998, 997 } ) {
+        test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( window ) );
+      }
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 10000;
+
+      TCPSenderTestHarness test { "NewReno holds the window during recovery", cfg };
+      test.execute( EnableFastRetransmit {} );
+      test.execute( SetCongestionControl { CongestionControl::Algorithm::NewReno } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push( string( 5000, 'x' ) ) );
+      for ( int i = 0; i < 5; i++ ) {
+        test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      }
+
+      // The first and third segments are lost: half of the flight becomes the window.
+      for ( int i = 0; i < 3; i++ ) {
+        test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      }
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_payload_size( 1000 ) );
+      test.execute( ExpectCongestionWindow { 2500 } );
+      test.execute( AckReceived { Wrap32 { isn + 2001 } }.with_win( 10000 ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 2001 ).with_payload_size( 1000 ) );
+      test.execute( ExpectCongestionWindow { 2500 } );
+      test.execute( AckReceived { Wrap32 { isn + 5001 } }.with_win( 10000 ) );
+      test.execute( ExpectCongestionWindow { 2500 } );
+
+      // Once recovery is over, a window's worth of ACKs grows it by a segment again.
+      test.execute( Push( string( 3000, 'y' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 500 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 7501 } }.with_win( 10000 ) );
+      test.execute( ExpectCongestionWindow { 3500 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
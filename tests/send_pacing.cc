@@ -0,0 +1,184 @@
+#include "bottleneck.hh"
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    constexpr uint64_t mss = TCPConfig::MAX_PAYLOAD_SIZE;
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      // 1000 bytes/ms, two segments deep (the bucket starts full, and the SYN takes one token)
+      TCPSenderTestHarness test { "token bucket releases a segment per ms", cfg };
+      test.execute( EnablePacing { 1'000'000, 1.25, 2 } );
+      test.execute( ExpectPacingRate { 1'000'000 } ); // an explicit rate is used as is
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 64'000 ) );
+
+      // The second segment may overdraw the bucket by the SYN's token
+      test.execute( Push { string( 10 * mss, 'x' ) } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_payload_size( mss ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 + mss ).with_payload_size( mss ) );
+      test.execute( ExpectNoSegment {} );
+
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 + 2 * mss ) );
+      test.execute( ExpectNoSegment {} );
+
+      // A long tick releases a tick's worth of segments
+      test.execute( Tick { 5 } );
+      for ( uint64_t i = 3; i < 8; i++ ) {
+        test.execute( ExpectMessage {}.with_seqno( isn + 1 + i * mss ) );
+      }
+      test.execute( ExpectNoSegment {} );
+
+      // push() does not send past the tokens, and no time brings no tokens
+      test.execute( Push {} );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 0 } );
+      test.execute( ExpectNoSegment {} );
+
+      // Retransmissions are not held back
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 + 8 * mss ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 + 9 * mss ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "a segment longer than the bucket is deep still goes out", cfg };
+      test.execute( EnablePacing { 100'000, 1.25, 1 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 64'000 ) );
+      test.execute( Push { string( mss, 'x' ) }.with_close() );
+      test.execute( ExpectMessage {}.with_fin( true ).with_payload_size( mss ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "the bucket is counted in segments of the size in use", cfg };
+      test.execute( EnablePacing { 1'000, 1.25, 2 } );
+      test.execute( SetMaxPayloadSize { 100 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 64'000 ) );
+      test.execute( Push { string( 10 * mss, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 100 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 100 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "the window is paced out over the RTT", cfg };
+      test.execute( SetCongestionControl { CongestionControl::Algorithm::NewReno } );
+      test.execute( EnablePacing { 0, 1.25, 2 } );
+      test.execute( ExpectPacingRate { nullopt } ); // nothing to derive a rate from before an RTT sample
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { isn + 1 }.with_win( 64'000 ) );
+
+      // The window (10 segments, and a byte for the SYN) over 10 ms, with 25% to spare
+      test.execute( ExpectPacingRate { ( 10 * mss + 1 ) * 125 } );
+      test.execute( Push { string( 20 * mss, 'x' ) } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 + mss ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( Tick { 1 } );
+      test.execute( Tick { 1 } );
+      test.execute( Tick { 1 } );
+      for ( uint64_t i = 2; i < 8; i++ ) {
+        test.execute( ExpectMessage {}.with_seqno( isn + 1 + i * mss ) );
+      }
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "BBR paces at the rate it measures", cfg };
+      test.execute( SetCongestionControl { CongestionControl::Algorithm::BBR } );
+      test.execute( EnablePacing { 0, 1.25, 2 } );
+      test.execute( ExpectPacingRate { nullopt } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 64'000 ) );
+      test.execute( Push { string( 2 * mss, 'x' ) } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 + mss ) );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { isn + 1 + 2 * mss }.with_win( 64'000 ) );
+
+      // The flight and the SYN (2001 bytes) in 10 ms; startup paces above that (by 2/ln 2), pacing adds its 25%
+      test.execute( ExpectPacingRate { 722'861 } );
+    }
+
+    // 1 MSS per ms behind a queue only four segments deep, 20 ms RTT. Without congestion control, the sender
+    // paces at the link rate; otherwise at the rate it derives.
+    const Bottleneck::Config link { .bytes_per_ms = 1000, .delay_ms = 10, .queue_limit = 4, .loss_rate = 0 };
+    constexpr uint64_t link_rate = 1'000'000; // bytes/s
+
+    for ( const auto algorithm : { CongestionControl::Algorithm::None, CongestionControl::Algorithm::BBR } ) {
+      for ( const bool pacing : { false, true } ) {
+        TCPConfig cfg;
+        cfg.rt_timeout = 100;
+
+        TCPSenderTestHarness test { string { CongestionControl::name( algorithm ) }
+                                      + ( pacing ? ", paced, rarely overflows a shallow buffer"
+                                                 : ", unpaced, overflows a shallow buffer" ),
+                                    cfg };
+        test.execute( EnableSACK {} );
+        test.execute( EnableFastRetransmit {} );
+        test.execute( EnableAdaptiveRTO { 10, TCPConfig::RTO_MAX } );
+        test.execute( SetCongestionControl { algorithm } );
+        const bool fixed_rate = algorithm == CongestionControl::Algorithm::None;
+        if ( pacing ) {
+          // at the link rate, nothing overflows; BBR probes above its estimate, but far less than it bursts
+          test.execute( EnablePacing { fixed_rate ? link_rate : 0, 1.25, 2 } );
+          test.execute( TransferThroughBottleneck { link, 1'000'000 }
+                          .within_ms( fixed_rate ? 1500 : 3000 )
+                          .with_queue_drops_at_most( fixed_rate ? 0 : 200 ) );
+        } else {
+          test.execute(
+            TransferThroughBottleneck { link, 1'000'000 }.with_queue_drops_at_least( fixed_rate ? 1000 : 300 ) );
+        }
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -198,6 +198,40 @@ int main()
       test.execute( ExpectSeqnosInFlight { 0 } );
       test.execute( HasError { false } );
     }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      // Segments are cut from the middle of the send buffer's chunks, and cut again when retransmitted.
+      TCPSenderTestHarness test { "retx payload spanning chunks", cfg, ByteStream::Storage::Chunked };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 2 ) );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ) );
+      test.execute( Push { "bc" } );
+      test.execute( ExpectMessage {}.with_data( "b" ) );
+      test.execute( Push { "de" } );
+      test.execute( Push { "fgh" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 2 } }.with_win( 6 ) );
+      test.execute( ExpectMessage {}.with_data( "cdefg" ) );
+      test.execute( Push { "ijk" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 3 } }.with_win( 6 ) );
+      test.execute( ExpectMessage {}.with_data( "h" ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 3 ).with_data( "cdefg" ) );
+      test.execute( AckReceived { Wrap32 { isn + 5 } }.with_win( 10 ) );
+      test.execute( ExpectMessage {}.with_data( "ijk" ) );
+      test.execute( AckReceived { Wrap32 { isn + 8 } }.with_win( 10 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 8 ).with_data( "h" ) );
+      test.execute( HasError { false } );
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return 1;
@@ -0,0 +1,152 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "RTO follows SRTT and RTTVAR", cfg };
+      test.execute( EnableAdaptiveRTO { 10, 5000 } );
+      test.execute( ExpectSmoothedRTT { nullopt } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 40 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      // first sample: SRTT = 40, RTTVAR = 20, RTO = SRTT + 4 * RTTVAR
+      test.execute( ExpectSmoothedRTT { 40 } );
+      test.execute( ExpectRTO { 120 } );
+
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Tick { 20 } );
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 1000 ) );
+      // RTTVAR = 3/4 * 20 + 1/4 * |40 - 20| = 20, SRTT = 7/8 * 40 + 1/8 * 20 = 37.5
+      test.execute( ExpectSmoothedRTT { 37 } );
+      test.execute( ExpectRTO { 117 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "no samples from retransmitted segments (Karn)", cfg };
+      test.execute( EnableAdaptiveRTO { 10, 5000 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 40 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( ExpectRTO { 120 } );
+
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Tick { 119 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( ExpectRTO { 240 } );
+      test.execute( ExpectConsecutiveRetransmissions { 1 } );
+
+      // this ACK may be for either copy, so it gives no sample, but it does end the backoff
+      test.execute( Tick { 5 } );
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 1000 ) );
+      test.execute( ExpectSmoothedRTT { 40 } );
+      test.execute( ExpectRTO { 120 } );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "RTO is clamped to the minimum", cfg };
+      test.execute( EnableAdaptiveRTO { 200, 5000 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 1 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( ExpectSmoothedRTT { 1 } );
+      test.execute( ExpectRTO { 200 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 100;
+
+      TCPSenderTestHarness test { "backoff is clamped to the maximum", cfg };
+      test.execute( EnableAdaptiveRTO { 10, 300 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 100 } );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( ExpectRTO { 200 } );
+      test.execute( Tick { 200 } );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( ExpectRTO { 300 } );
+      test.execute( Tick { 300 } );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( ExpectRTO { 300 } );
+      test.execute( ExpectConsecutiveRetransmissions { 3 } );
+    }
+
+    // With timestamps, the ACK of a retransmission echoes the TSval of the copy that arrived: a valid sample,
+    // which Karn's algorithm has to skip without them.
+    for ( const bool timestamps : { true, false } ) {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 100;
+
+      TCPSenderTestHarness test { timestamps ? "retransmissions are timed by the echoed timestamp"
+                                             : "no timestamps, no samples from retransmissions",
+                                  cfg };
+      test.execute( EnableAdaptiveRTO { 1, 60000 } );
+      if ( timestamps ) {
+        test.execute( EnableTimestamps {} );
+      }
+      const auto stamp = [&]( uint32_t now ) { return timestamps ? optional { now } : nullopt; };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_tsval( stamp( 0 ) ) );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).with_tsecr( 0 ) );
+      test.execute( ExpectSmoothedRTT { 10 } );
+      test.execute( ExpectRTO { 30 } );
+
+      // The segment is lost; the retransmission is stamped with the time it was resent.
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_tsval( stamp( 10 ) ) );
+      test.execute( Tick { 30 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_tsval( stamp( 40 ) ) );
+      test.execute( ExpectTimestamp { stamp( 40 ) } );
+
+      test.execute( Tick { 5 } );
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 1000 ).with_tsecr( 40 ) );
+      test.execute( ExpectSmoothedRTT { timestamps ? 9 : 10 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
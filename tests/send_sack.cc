@@ -0,0 +1,86 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "SYN offers SACK only when enabled", cfg };
+      test.execute( EnableSACK {} );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_sack_permitted( true ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_syn( false ).with_sack_permitted( false ).with_data( "abc" ) );
+
+      TCPSenderTestHarness plain { "SYN without SACK", cfg };
+      plain.execute( Push {} );
+      plain.execute( ExpectMessage {}.with_syn( true ).with_sack_permitted( false ).with_seqno( isn ) );
+    }
+
+    for ( const bool sack : { true, false } ) {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = rto;
+
+      TCPSenderTestHarness test { sack ? "timeout retransmits every SACK hole" : "timeout without SACK", cfg };
+      if ( sack ) {
+        test.execute( EnableSACK {} );
+      }
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      for ( const string data : { "abc", "def", "ghi", "jkl", "mno" } ) {
+        test.execute( Push( data ) );
+        test.execute( ExpectMessage {}.with_data( data ) );
+      }
+
+      // The peer holds "def" and "jkl" (a sender without SACK ignores that), but "abc", "ghi" and "mno" are lost.
+      test.execute( AckReceived { Wrap32 { isn + 1 } }
+                      .with_win( 1000 )
+                      .with_sack( isn + 4, isn + 7 )
+                      .with_sack( isn + 10, isn + 13 ) );
+      test.execute( ExpectSeqnosInFlight { 15 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      if ( sack ) {
+        test.execute( ExpectMessage {}.with_data( "ghi" ).with_seqno( isn + 7 ) );
+      }
+      test.execute( ExpectNoSegment {} );
+
+      // The timeout also clears the scoreboard (the receiver may have reneged): the next one resends the front.
+      test.execute( Tick { 2 * rto } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+
+      // Once the holes are filled, the cumulative ACK covers the SACKed segments too.
+      test.execute( AckReceived { Wrap32 { isn + 13 } }.with_win( 1000 ) );
+      test.execute( ExpectSeqnosInFlight { 3 } );
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_data( "mno" ).with_seqno( isn + 13 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -165,6 +165,29 @@ int main()
       test.execute( ExpectSeqno { Wrap32 { isn + 1 + 3 } } );
     }
 
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.send_capacity = 100'000;
+
+      TCPSenderTestHarness test { "Segments as large as the MSS allows", cfg };
+      test.execute( OfferMSS { 8960 } );
+      test.execute( SetMaxPayloadSize { 8960 } );
+      test.execute( SetCongestionControl { CongestionControl::Algorithm::NewReno } );
+      test.execute( ExpectCongestionWindow { 10 * 8960 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_mss( 8960 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 60'000 ) );
+      test.execute( Push { string( 20'000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_no_flags().with_mss( nullopt ).with_payload_size( 8960 ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 8960 ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 2080 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SetMaxPayloadSize { 4480 } );
+      test.execute( ExpectCongestionWindow { 10 * 4480 } );
+    }
+
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return 1;
@@ -137,6 +137,23 @@ int main()
       test.execute( ExpectMessage {}.with_fin( true ).with_data( "4567" ) );
       test.execute( ExpectNoSegment {} );
     }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.send_capacity = 300'000;
+
+      TCPSenderTestHarness test { "Window scaling lets the window exceed 64 KiB", cfg };
+      test.execute( OfferWindowScale { 3 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_window_scale( 3 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 200'000 ) );
+      test.execute( Push { string( 300'000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_no_flags().with_window_scale( nullopt ).with_seqno( isn + 1 ) );
+      test.execute( ExpectSeqnosInFlight { 200'000 } );
+    }
+
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return 1;
@@ -52,10 +52,12 @@ struct SenderTestStep : public TestStep<SenderAndOutput>
 class TCPSenderTestHarness : public TestHarness<SenderAndOutput>
 {
 public:
-  TCPSenderTestHarness( std::string name, TCPConfig config )
+  TCPSenderTestHarness( std::string name,
+                        TCPConfig config,
+                        ByteStream::Storage storage = ByteStream::Storage::Ring )
     : TestHarness( move( name ),
                    "initial_RTO_ms=" + to_string( config.rt_timeout ) + " and ISN=" + to_string( config.isn ),
-                   { TCPSender { ByteStream { config.send_capacity }, config.isn, config.rt_timeout } } )
+                   { TCPSender { ByteStream { config.send_capacity, storage }, config.isn, config.rt_timeout } } )
   {}
 
   template<std::derived_from<TestStep<TCPSender>> T>
@@ -104,6 +106,37 @@ struct ExpectConsecutiveRetransmissions : public ExpectNumber<TCPSender, uint64_
   uint64_t value( const TCPSender& sender ) const override { return sender.consecutive_retransmissions(); }
 };
 
+struct ExpectRTO : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "rto"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.rto(); }
+};
+
+struct ExpectSmoothedRTT : public ExpectNumber<TCPSender, std::optional<uint64_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "smoothed_rtt"; }
+  std::optional<uint64_t> value( const TCPSender& sender ) const override { return sender.smoothed_rtt(); }
+};
+
+struct ExpectTimestamp : public ExpectNumber<TCPSender, std::optional<uint32_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "make_empty_message().TSval"; }
+  std::optional<uint32_t> value( const TCPSender& sender ) const override
+  {
+    return sender.make_empty_message().TSval;
+  }
+};
+
+struct ExpectCongestionWindow : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "congestion_window"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.congestion_window(); }
+};
+
 struct ExpectNoSegment : public Expectation<SenderAndOutput>
 {
   std::string description() const override { return "nothing to send"; }
@@ -116,6 +149,110 @@ struct ExpectNoSegment : public Expectation<SenderAndOutput>
   constexpr std::string obj() const override { return "TCPSender"; }
 };
 
+struct EnableSACK : public Action<TCPSender>
+{
+  std::string description() const override { return "enable SACK"; }
+  void execute( TCPSender& sender ) const override { sender.enable_sack(); }
+};
+
+struct EnableFastRetransmit : public Action<TCPSender>
+{
+  std::string description() const override { return "enable fast retransmit"; }
+  void execute( TCPSender& sender ) const override { sender.enable_fast_retransmit(); }
+};
+
+struct SetCongestionControl : public Action<TCPSender>
+{
+  CongestionControl::Algorithm algorithm_;
+
+  explicit SetCongestionControl( CongestionControl::Algorithm algorithm ) : algorithm_( algorithm ) {}
+  std::string description() const override
+  {
+    return "set congestion control to " + std::string { CongestionControl::name( algorithm_ ) };
+  }
+  void execute( TCPSender& sender ) const override { sender.set_congestion_control( algorithm_ ); }
+};
+
+struct OfferWindowScale : public Action<TCPSender>
+{
+  uint8_t shift_;
+
+  explicit OfferWindowScale( uint8_t shift ) : shift_( shift ) {}
+  std::string description() const override { return "offer window scale shift " + std::to_string( shift_ ); }
+  void execute( TCPSender& sender ) const override { sender.offer_window_scale( shift_ ); }
+};
+
+struct OfferMSS : public Action<TCPSender>
+{
+  uint16_t mss_;
+
+  explicit OfferMSS( uint16_t mss ) : mss_( mss ) {}
+  std::string description() const override { return "offer MSS " + std::to_string( mss_ ); }
+  void execute( TCPSender& sender ) const override { sender.offer_mss( mss_ ); }
+};
+
+struct SetMaxPayloadSize : public Action<TCPSender>
+{
+  uint64_t size_;
+
+  explicit SetMaxPayloadSize( uint64_t size ) : size_( size ) {}
+  std::string description() const override { return "set max payload size to " + std::to_string( size_ ); }
+  void execute( TCPSender& sender ) const override { sender.set_max_payload_size( size_ ); }
+};
+
+struct EnableTimestamps : public Action<TCPSender>
+{
+  std::string description() const override { return "enable timestamps"; }
+  void execute( TCPSender& sender ) const override { sender.enable_timestamps(); }
+};
+
+struct EnableAdaptiveRTO : public Action<TCPSender>
+{
+  uint64_t min_RTO_ms_;
+  uint64_t max_RTO_ms_;
+
+  EnableAdaptiveRTO( uint64_t min_RTO_ms, uint64_t max_RTO_ms )
+    : min_RTO_ms_( min_RTO_ms ), max_RTO_ms_( max_RTO_ms )
+  {}
+  std::string description() const override
+  {
+    return "enable adaptive RTO in [" + std::to_string( min_RTO_ms_ ) + ", " + std::to_string( max_RTO_ms_ )
+           + "] ms";
+  }
+  void execute( TCPSender& sender ) const override { sender.enable_adaptive_rto( min_RTO_ms_, max_RTO_ms_ ); }
+};
+
+struct EnablePacing : public Action<TCPSender>
+{
+  uint64_t rate_;
+  double gain_;
+  uint64_t burst_segments_;
+
+  EnablePacing( uint64_t rate, double gain, uint64_t burst_segments )
+    : rate_( rate ), gain_( gain ), burst_segments_( burst_segments )
+  {}
+  std::string description() const override
+  {
+    std::ostringstream desc;
+    desc << "enable pacing at ";
+    if ( rate_ ) {
+      desc << rate_ << " bytes/s";
+    } else {
+      desc << gain_ << "x the derived rate";
+    }
+    desc << ", " << burst_segments_ << " segments deep";
+    return desc.str();
+  }
+  void execute( TCPSender& sender ) const override { sender.enable_pacing( rate_, gain_, burst_segments_ ); }
+};
+
+struct ExpectPacingRate : public ExpectNumber<TCPSender, std::optional<uint64_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "pacing_rate"; }
+  std::optional<uint64_t> value( const TCPSender& sender ) const override { return sender.pacing_rate(); }
+};
+
 struct SetError : public Action<TCPSender>
 {
   std::string description() const override { return "set_error"; }
@@ -222,14 +359,21 @@ struct Receive : public Action<SenderAndOutput>
   std::string description() const override
   {
     std::ostringstream desc;
-    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size << ")";
+    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size;
+    for ( const auto& block : msg_.sack ) {
+      desc << ", sack=[" << block.left << ", " << block.right << ")";
+    }
+    if ( msg_.TSecr ) {
+      desc << ", TSecr=" << *msg_.TSecr;
+    }
+    desc << ")";
     if ( push_ ) {
       desc << ", then push";
     }
     return desc.str();
   }
 
-  Receive& with_win( uint16_t win )
+  Receive& with_win( uint32_t win )
   {
     msg_.window_size = win;
     return *this;
@@ -243,6 +387,18 @@ struct Receive : public Action<SenderAndOutput>
     }
   }
 
+  Receive& with_sack( Wrap32 left, Wrap32 right )
+  {
+    msg_.sack.push_back( { left, right } );
+    return *this;
+  }
+
+  Receive& with_tsecr( uint32_t tsecr )
+  {
+    msg_.TSecr = tsecr;
+    return *this;
+  }
+
   Receive& without_push()
   {
     push_ = false;
@@ -280,11 +436,19 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
   std::optional<bool> syn {};
   std::optional<bool> fin {};
   std::optional<bool> rst {};
+  std::optional<bool> sack_permitted {};
   std::optional<Wrap32> seqno {};
   std::optional<std::string> data {};
   std::optional<size_t> payload_size {};
+  std::optional<std::optional<uint8_t>> window_scale {};
+  std::optional<std::optional<uint16_t>> mss {};
+  std::optional<std::optional<uint32_t>> tsval {};
 
-  bool empty() const { return not( syn or fin or rst or seqno or data or payload_size ); }
+  bool empty() const
+  {
+    return not( syn or fin or rst or sack_permitted or seqno or data or payload_size or window_scale or mss
+                or tsval );
+  }
 
   ExpectMessage& with_syn( bool syn_ )
   {
@@ -304,6 +468,30 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     return *this;
   }
 
+  ExpectMessage& with_sack_permitted( bool sack_permitted_ )
+  {
+    sack_permitted = sack_permitted_;
+    return *this;
+  }
+
+  ExpectMessage& with_window_scale( std::optional<uint8_t> window_scale_ )
+  {
+    window_scale = window_scale_;
+    return *this;
+  }
+
+  ExpectMessage& with_mss( std::optional<uint16_t> mss_ )
+  {
+    mss = mss_;
+    return *this;
+  }
+
+  ExpectMessage& with_tsval( std::optional<uint32_t> tsval_ )
+  {
+    tsval = tsval_;
+    return *this;
+  }
+
   ExpectMessage& with_rst( bool rst_ )
   {
     rst = rst_;
@@ -339,6 +527,18 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( syn.has_value() ) {
       o << ( syn.value() ? " +SYN" : " -SYN" );
     }
+    if ( sack_permitted.has_value() ) {
+      o << ( sack_permitted.value() ? " +SACK_PERMITTED" : " -SACK_PERMITTED" );
+    }
+    if ( window_scale.has_value() ) {
+      o << ( window_scale.value() ? " WS=" + std::to_string( *window_scale.value() ) : " -WS" );
+    }
+    if ( mss.has_value() ) {
+      o << ( mss.value() ? " MSS=" + std::to_string( *mss.value() ) : " -MSS" );
+    }
+    if ( tsval.has_value() ) {
+      o << ( tsval.value() ? " TSval=" + std::to_string( *tsval.value() ) : " -TSval" );
+    }
 
     if ( data.has_value() and data.value().size() <= 32 ) {
       o << " payload=\"" << pretty_print( data.value(), 32 ) << "\"";
@@ -377,14 +577,26 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
 
     const TCPSenderMessage seg = ss.expect_message();
 
-    if ( seg.payload.size() > TCPConfig::MAX_PAYLOAD_SIZE ) {
+    if ( seg.payload.size() > ss.sender.max_payload_size() ) {
       throw ExpectationViolation( "sent a message with a " + std::to_string( seg.payload.size() )
                                   + "-byte payload, which is longer than the maximum ("
-                                  + std::to_string( TCPConfig::MAX_PAYLOAD_SIZE ) + ")" );
+                                  + std::to_string( ss.sender.max_payload_size() ) + ")" );
     }
     if ( syn.has_value() and seg.SYN != syn.value() ) {
       throw MessageExpectationViolation( seg, "SYN flag", syn.value(), seg.SYN );
     }
+    if ( sack_permitted.has_value() and seg.SACK_permitted != sack_permitted.value() ) {
+      throw MessageExpectationViolation( seg, "SACK_permitted flag", sack_permitted.value(), seg.SACK_permitted );
+    }
+    if ( window_scale.has_value() and seg.window_scale != window_scale.value() ) {
+      throw MessageExpectationViolation( seg, "window scale option", window_scale.value(), seg.window_scale );
+    }
+    if ( mss.has_value() and seg.MSS != mss.value() ) {
+      throw MessageExpectationViolation( seg, "MSS option", mss.value(), seg.MSS );
+    }
+    if ( tsval.has_value() and seg.TSval != tsval.value() ) {
+      throw MessageExpectationViolation( seg, "TSval", tsval.value(), seg.TSval );
+    }
     if ( fin.has_value() and seg.FIN != fin.value() ) {
       throw MessageExpectationViolation( seg, "FIN flag", fin.value(), seg.FIN );
     }
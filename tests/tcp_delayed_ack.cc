@@ -0,0 +1,128 @@
+#include "tcp_config.hh"
+#include "tcp_peer_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// The server delays its ACKs by `ack_delay` ms
+TCPConfig server_config( uint16_t ack_delay, size_t recv_capacity = TCPConfig::DEFAULT_CAPACITY )
+{
+  TCPConfig cfg;
+  cfg.ack_delay = ack_delay;
+  cfg.recv_capacity = recv_capacity;
+  return cfg;
+}
+
+// The handshake is done, and nothing is waiting to be acknowledged
+void connect( TCPPeerTestHarness& test )
+{
+  test.execute( Handshake {} );
+  test.execute( ExpectPeerInFlight { Peer::Server, 0 } );
+  test.execute( ExpectSegmentsQueued { Peer::Client, 0 } );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    for ( const uint16_t ack_delay : { 0, 40 } ) {
+      TCPPeerTestHarness test { ack_delay ? "bulk transfer: every second segment is acknowledged"
+                                          : "bulk transfer: every segment is acknowledged",
+                                TCPConfig {},
+                                server_config( ack_delay ) };
+      connect( test );
+      test.execute( Write { Peer::Client, string( 20 * TCPConfig::MAX_PAYLOAD_SIZE, 'x' ) } );
+      test.execute( ExpectSegmentsQueued { Peer::Server, 20 } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( ExpectSegmentsReceived { Peer::Server, 21 } ); // the SYN and 20 data segments
+      test.execute( ExpectSegmentsQueued { Peer::Client, ack_delay ? 10UL : 20UL } );
+      test.execute( ExpectPureAcksSent { Peer::Server, ack_delay ? 10UL : 20UL } );
+      test.execute(
+        ExpectLastSegment { Peer::Client }.with_ackno( Wrap32 { 138 + 20 * TCPConfig::MAX_PAYLOAD_SIZE } ) );
+    }
+
+    {
+      TCPPeerTestHarness test { "a lone segment's ACK waits for the timer", TCPConfig {}, server_config( 40 ) };
+      connect( test );
+      test.execute( Write { Peer::Client, "hello" } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( ExpectSegmentsQueued { Peer::Client, 0 } );
+      test.execute( TickPeer { Peer::Server, 39 } );
+      test.execute( ExpectSegmentsQueued { Peer::Client, 0 } );
+      test.execute( TickPeer { Peer::Server, 1 } );
+      test.execute( ExpectSegmentsQueued { Peer::Client, 1 } );
+      test.execute( ExpectLastSegment { Peer::Client }.with_ackno( Wrap32 { 143 } ) );
+      test.execute( ExpectDelayedAcksSent { Peer::Server, 1 } );
+
+      // Data going the other way carries the ACK, and cancels the timer.
+      test.execute( Write { Peer::Client, "again" } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( Write { Peer::Server, "reply" } );
+      test.execute( ExpectSegmentsQueued { Peer::Client, 2 } );
+      test.execute( ExpectLastSegment { Peer::Client }.with_ackno( Wrap32 { 148 } ).with_payload_size( 5 ) );
+      test.execute( TickPeer { Peer::Server, 40 } );
+      test.execute( ExpectSegmentsQueued { Peer::Client, 2 } );
+    }
+
+    {
+      TCPPeerTestHarness test {
+        "out-of-order segments, hole fills and FINs are acknowledged at once", TCPConfig {}, server_config( 40 ) };
+      connect( test );
+      test.execute( Write { Peer::Client, "abc" } );
+      test.execute( Write { Peer::Client, "def" } );
+      test.execute( Write { Peer::Client, "ghi" } );
+      test.execute( DropSegment { Peer::Server, 0 } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( ExpectSegmentsQueued { Peer::Client, 2 } );
+
+      test.execute( TickPeer { Peer::Client, TCPConfig::TIMEOUT_DFLT } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( ExpectSegmentsQueued { Peer::Client, 3 } );
+      test.execute( ExpectLastSegment { Peer::Client }.with_ackno( Wrap32 { 147 } ) );
+
+      test.execute( Write { Peer::Client }.with_close() );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( ExpectSegmentsQueued { Peer::Client, 4 } );
+      test.execute( ExpectLastSegment { Peer::Client }.with_ackno( Wrap32 { 148 } ) );
+    }
+
+    {
+      constexpr size_t capacity = 4 * TCPConfig::MAX_PAYLOAD_SIZE;
+      TCPPeerTestHarness test {
+        "window updates are sent once half the buffer is free", TCPConfig {}, server_config( 40, capacity ) };
+      connect( test );
+      test.execute( Write { Peer::Client, string( capacity, 'x' ) } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( ExpectSegmentsQueued { Peer::Client, 2 } );
+      test.execute( ExpectLastSegment { Peer::Client }.with_window_size( 0 ) );
+
+      // A window opening from zero is announced at once
+      test.execute( Read { Peer::Server, TCPConfig::MAX_PAYLOAD_SIZE } );
+      test.execute( TickPeer { Peer::Server, 1 } );
+      test.execute( ExpectSegmentsQueued { Peer::Client, 3 } );
+      test.execute( ExpectLastSegment { Peer::Client }.with_window_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+
+      // A small increase can wait
+      test.execute( Read { Peer::Server, TCPConfig::MAX_PAYLOAD_SIZE } );
+      test.execute( TickPeer { Peer::Server, 1 } );
+      test.execute( ExpectSegmentsQueued { Peer::Client, 3 } );
+      test.execute( Read { Peer::Server, TCPConfig::MAX_PAYLOAD_SIZE } );
+      test.execute( TickPeer { Peer::Server, 1 } );
+      test.execute( ExpectSegmentsQueued { Peer::Client, 4 } );
+      test.execute( ExpectLastSegment { Peer::Client }.with_window_size( 3 * TCPConfig::MAX_PAYLOAD_SIZE ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+#include "tcp_config.hh"
+#include "tcp_peer_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+TCPConfig config( size_t mtu, bool sack = false, bool timestamps = false )
+{
+  TCPConfig cfg;
+  cfg.mtu = mtu;
+  cfg.sack = sack;
+  cfg.timestamps = timestamps;
+  cfg.send_capacity = 100'000;
+  return cfg;
+}
+
+// After the handshake, the client sends more than one segment's worth: the largest shows the negotiated size
+void largest_payload( const string& name, // NOLINT(*-swappable-*)
+                      const TCPConfig& client_cfg,
+                      const TCPConfig& server_cfg,
+                      size_t expected )
+{
+  TCPPeerTestHarness test { name, client_cfg, server_cfg };
+  test.execute( Handshake {} );
+  test.execute( Write { Peer::Client, string( 50'000, 'x' ) } );
+  test.execute( ExpectLargestPayload { Peer::Server, expected } );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    {
+      TCPSegmentTestHarness test {
+        "MSS option survives the round trip",
+        { .seqno = Wrap32 { 1000 }, .SYN = true, .SACK_permitted = true, .window_scale = 7, .MSS = 8960 },
+        { .ackno = Wrap32 { 77 }, .window_size = 5000 } };
+      test.execute( RoundTrip {} );
+      test.execute( ExpectMSSOption { 8960 } );
+      test.execute( ExpectWindowScaleOption { 7 } );
+      test.execute( ExpectSACKPermittedOption { true } );
+    }
+
+    {
+      TCPSegmentTestHarness test {
+        "no MSS option unless set", { .seqno = Wrap32 { 1000 } }, { .ackno = Wrap32 { 77 } } };
+      test.execute( RoundTrip {} );
+      test.execute( ExpectMSSOption { nullopt } );
+    }
+
+    largest_payload( "jumbo frames carry 8960 bytes", config( 9000 ), config( 9000 ), 8960 );
+    largest_payload( "the smaller MSS of the two ends wins", config( 9000 ), config( 1500 ), 1460 );
+    largest_payload( "the local MTU limits the segments too", config( 1500 ), config( 9000 ), 1460 );
+    largest_payload(
+      "SACK blocks take no room from full-sized segments", config( 9000, true ), config( 9000, true ), 8960 );
+    largest_payload( "with timestamps and SACK, segments leave room for the timestamps only",
+                     config( 9000, true, true ),
+                     config( 9000, true, true ),
+                     8960 - TCPSegment::TIMESTAMPS_OPTION_LENGTH );
+    largest_payload( "with timestamps, segments leave room for them",
+                     config( 9000, false, true ),
+                     config( 9000, false, true ),
+                     8960 - TCPSegment::TIMESTAMPS_OPTION_LENGTH );
+    largest_payload(
+      "no room for timestamps the peer did not offer", config( 9000, false, true ), config( 9000 ), 8960 );
+    largest_payload( "without an MTU, keep the old size", config( 0 ), config( 0 ), TCPConfig::MAX_PAYLOAD_SIZE );
+
+    // SACK blocks ride on a full-sized segment only as far as they fit the path MSS
+    {
+      TCPPeerTestHarness test { "SACK blocks are dropped from segments they would not fit",
+                                config( 9000, true, true ),
+                                config( 9000, true, true ) };
+      test.execute( Handshake {} );
+      test.execute( Write { Peer::Client, string( 3 * 8948, 'x' ) } );
+      test.execute( DropSegment { Peer::Server, 0 } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( ExpectLastSegment { Peer::Client }.with_sack_blocks( 1 ) );
+      test.execute( Write { Peer::Server, "hello" } );
+      test.execute( ExpectLastSegment { Peer::Client }.with_payload_size( 5 ).with_sack_blocks( 1 ) );
+      test.execute( Write { Peer::Server, string( 8948, 'x' ) } );
+      test.execute( ExpectLastSegment { Peer::Client }.with_payload_size( 8948 ).with_sack_blocks( 0 ) );
+    }
+
+    // A retransmitted SYN must not renegotiate the options, nor reset the congestion window built up since
+    {
+      TCPConfig cfg = config( 9000 );
+      cfg.congestion_control = CongestionControl::Algorithm::NewReno;
+
+      TCPPeerTestHarness test { "a duplicate SYN keeps the negotiated MSS and window", cfg, cfg };
+      test.execute( Write { Peer::Client } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( RecordSegment { Peer::Client, 0 } );
+      test.execute( Deliver { Peer::Client } );
+      test.execute( Write { Peer::Client, string( 50'000, 'x' ) } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( Deliver { Peer::Client } );
+      test.execute( ExpectPeerCongestionWindow { Peer::Client, 139'601 } ); // grown from 10 * 8960
+      test.execute( ReplaySegment { Peer::Client } );
+      test.execute( Deliver { Peer::Client } );
+      test.execute( ExpectPeerCongestionWindow { Peer::Client, 139'601 } );
+      test.execute( Write { Peer::Client, string( 20'000, 'x' ) } );
+      test.execute( ExpectLastSegment { Peer::Server }.with_payload_size( 20'000 - 2 * 8960 ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,523 @@
+#pragma once
+
+#include "common.hh"
+#include "parser.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Serialize a message into a segment and parse it back, the way it crosses the network
+inline TCPMessage round_trip( const TCPMessage& message )
+{
+  TCPSegment segment { .message = { borrow( message.sender.get() ), borrow( message.receiver.get() ) } };
+  segment.compute_checksum( 0 );
+  Serializer serializer;
+  segment.serialize( serializer );
+
+  TCPSegment parsed;
+  Parser parser { serializer.finish() };
+  parsed.parse( parser, 0 );
+  if ( parser.has_error() ) {
+    throw ExpectationViolation( "sent a segment that did not parse" );
+  }
+  return std::move( parsed.message );
+}
+
+/* A single segment, for testing how its options are serialized */
+
+class TCPSegmentTestHarness : public TestHarness<TCPMessage>
+{
+public:
+  TCPSegmentTestHarness( std::string test_name, TCPSenderMessage sender, TCPReceiverMessage receiver )
+    : TestHarness( move( test_name ), to_string( sender ), { std::move( sender ), std::move( receiver ) } )
+  {}
+};
+
+struct RoundTrip : public Action<TCPMessage>
+{
+  std::string description() const override { return "serialize, then parse back"; }
+  void execute( TCPMessage& msg ) const override { msg = round_trip( msg ); }
+  constexpr std::string obj() const override { return "TCPSegment"; }
+};
+
+template<typename Num>
+struct ExpectSegmentNumber : public ExpectNumber<TCPMessage, Num>
+{
+  using ExpectNumber<TCPMessage, Num>::ExpectNumber;
+  constexpr std::string obj() const override { return "TCPSegment"; }
+};
+
+struct ExpectWindowScaleOption : public ExpectSegmentNumber<std::optional<uint8_t>>
+{
+  using ExpectSegmentNumber::ExpectSegmentNumber;
+  std::string name() const override { return "window_scale"; }
+  std::optional<uint8_t> value( const TCPMessage& msg ) const override { return msg.sender->window_scale; }
+};
+
+struct ExpectMSSOption : public ExpectSegmentNumber<std::optional<uint16_t>>
+{
+  using ExpectSegmentNumber::ExpectSegmentNumber;
+  std::string name() const override { return "MSS"; }
+  std::optional<uint16_t> value( const TCPMessage& msg ) const override { return msg.sender->MSS; }
+};
+
+struct ExpectSACKPermittedOption : public ExpectSegmentNumber<bool>
+{
+  using ExpectSegmentNumber::ExpectSegmentNumber;
+  std::string name() const override { return "SACK_permitted"; }
+  bool value( const TCPMessage& msg ) const override { return msg.sender->SACK_permitted; }
+};
+
+struct ExpectTSval : public ExpectSegmentNumber<std::optional<uint32_t>>
+{
+  using ExpectSegmentNumber::ExpectSegmentNumber;
+  std::string name() const override { return "TSval"; }
+  std::optional<uint32_t> value( const TCPMessage& msg ) const override { return msg.sender->TSval; }
+};
+
+struct ExpectTSecr : public ExpectSegmentNumber<std::optional<uint32_t>>
+{
+  using ExpectSegmentNumber::ExpectSegmentNumber;
+  std::string name() const override { return "TSecr"; }
+  std::optional<uint32_t> value( const TCPMessage& msg ) const override { return msg.receiver->TSecr; }
+};
+
+struct ExpectSACKBlocks : public ExpectSegmentNumber<size_t>
+{
+  using ExpectSegmentNumber::ExpectSegmentNumber;
+  std::string name() const override { return "number of SACK blocks"; }
+  size_t value( const TCPMessage& msg ) const override { return msg.receiver->sack.size(); }
+};
+
+struct ExpectAdvertisedWindow : public ExpectSegmentNumber<uint32_t>
+{
+  using ExpectSegmentNumber::ExpectSegmentNumber;
+  std::string name() const override { return "window_size"; }
+  uint32_t value( const TCPMessage& msg ) const override { return msg.receiver->window_size; }
+};
+
+struct ExpectPayload : public ExpectSegmentNumber<std::string>
+{
+  using ExpectSegmentNumber::ExpectSegmentNumber;
+  std::string name() const override { return "payload"; }
+  std::string value( const TCPMessage& msg ) const override { return msg.sender->payload; }
+};
+
+/* Two peers, a client and a server, connected through serialized segments */
+
+enum class Peer
+{
+  Client,
+  Server
+};
+
+constexpr std::string peer_name( Peer peer )
+{
+  return peer == Peer::Client ? "client" : "server";
+}
+
+struct PeerPair
+{
+  TCPPeer client;
+  TCPPeer server;
+  std::vector<TCPMessage> to_client {};
+  std::vector<TCPMessage> to_server {};
+  std::optional<TCPMessage> recorded {};
+
+  TCPPeer& peer( Peer p ) { return p == Peer::Client ? client : server; }
+  const TCPPeer& peer( Peer p ) const { return p == Peer::Client ? client : server; }
+  std::vector<TCPMessage>& queue( Peer to ) { return to == Peer::Client ? to_client : to_server; }
+  const std::vector<TCPMessage>& queue( Peer to ) const { return to == Peer::Client ? to_client : to_server; }
+
+  // What `from` sends is queued, as it would arrive, for the other peer
+  auto transmit_from( Peer from )
+  {
+    return [this, from]( const TCPMessage& msg ) {
+      queue( from == Peer::Client ? Peer::Server : Peer::Client ).push_back( round_trip( msg ) );
+    };
+  }
+};
+
+class TCPPeerTestHarness : public TestHarness<PeerPair>
+{
+  static std::string describe( const TCPConfig& cfg )
+  {
+    std::ostringstream ss;
+    ss << "recv_capacity=" << cfg.recv_capacity << " mtu=" << cfg.mtu;
+    ss << ( cfg.sack ? " +SACK" : "" ) << ( cfg.timestamps ? " +timestamps" : "" )
+       << ( cfg.window_scale ? " +window_scale" : "" );
+    if ( cfg.ack_delay ) {
+      ss << " ack_delay=" << cfg.ack_delay;
+    }
+    return ss.str();
+  }
+
+public:
+  TCPPeerTestHarness( std::string test_name, const TCPConfig& client_cfg, const TCPConfig& server_cfg )
+    : TestHarness( move( test_name ),
+                   "client (" + describe( client_cfg ) + ") and server (" + describe( server_cfg ) + ")",
+                   { TCPPeer { client_cfg }, TCPPeer { server_cfg } } )
+  {}
+};
+
+struct PeerAction : public Action<PeerPair>
+{
+  Peer peer_;
+
+  explicit PeerAction( Peer peer ) : peer_( peer ) {}
+  constexpr std::string obj() const override { return peer_name( peer_ ); }
+};
+
+// The application writes to the peer's outbound stream (and maybe closes it), then the peer pushes
+struct Write : public PeerAction
+{
+  std::string data_;
+  bool close_ {};
+
+  explicit Write( Peer peer, std::string data = "" ) : PeerAction( peer ), data_( move( data ) ) {}
+
+  Write& with_close()
+  {
+    close_ = true;
+    return *this;
+  }
+
+  std::string description() const override
+  {
+    if ( data_.empty() ) {
+      return close_ ? "close outbound stream, then push" : "push";
+    }
+    return "write " + std::to_string( data_.size() ) + " bytes" + ( close_ ? ", close outbound stream" : "" )
+           + ", then push";
+  }
+
+  void execute( PeerPair& pair ) const override
+  {
+    if ( not data_.empty() ) {
+      pair.peer( peer_ ).outbound_writer().push( data_ );
+    }
+    if ( close_ ) {
+      pair.peer( peer_ ).outbound_writer().close();
+    }
+    pair.peer( peer_ ).push( pair.transmit_from( peer_ ) );
+  }
+};
+
+// The peer receives every segment queued for it, in order
+struct Deliver : public PeerAction
+{
+  using PeerAction::PeerAction;
+  std::string description() const override { return "receive the segments sent to it"; }
+  void execute( PeerPair& pair ) const override
+  {
+    for ( auto& msg : std::exchange( pair.queue( peer_ ), {} ) ) {
+      pair.peer( peer_ ).receive( std::move( msg ), pair.transmit_from( peer_ ) );
+    }
+  }
+};
+
+// The client's SYN, the server's SYN-ACK, and the client's ACK
+struct Handshake : public Action<PeerPair>
+{
+  std::string description() const override { return "three-way handshake"; }
+  void execute( PeerPair& pair ) const override
+  {
+    Write { Peer::Client }.execute( pair );
+    Deliver { Peer::Server }.execute( pair );
+    Deliver { Peer::Client }.execute( pair );
+    Deliver { Peer::Server }.execute( pair );
+  }
+  constexpr std::string obj() const override { return "client and server"; }
+};
+
+struct TickPeer : public PeerAction
+{
+  uint64_t ms_;
+
+  TickPeer( Peer peer, uint64_t ms ) : PeerAction( peer ), ms_( ms ) {}
+  std::string description() const override { return std::to_string( ms_ ) + " ms pass"; }
+  void execute( PeerPair& pair ) const override { pair.peer( peer_ ).tick( ms_, pair.transmit_from( peer_ ) ); }
+};
+
+// The application reads from the peer's inbound stream
+struct Read : public PeerAction
+{
+  uint64_t len_;
+
+  Read( Peer peer, uint64_t len ) : PeerAction( peer ), len_( len ) {}
+  std::string description() const override { return "read " + std::to_string( len_ ) + " bytes"; }
+  void execute( PeerPair& pair ) const override { pair.peer( peer_ ).inbound_reader().pop( len_ ); }
+};
+
+// A segment queued for the peer is lost on the way
+struct DropSegment : public PeerAction
+{
+  size_t index_;
+
+  DropSegment( Peer peer, size_t index ) : PeerAction( peer ), index_( index ) {}
+  std::string description() const override
+  {
+    return "segment #" + std::to_string( index_ ) + " sent to it is lost";
+  }
+  void execute( PeerPair& pair ) const override
+  {
+    auto& queue = pair.queue( peer_ );
+    queue.erase( queue.begin() + static_cast<std::ptrdiff_t>( index_ ) );
+  }
+};
+
+// Keep a copy of a segment queued for the peer, to replay it later as a duplicate
+struct RecordSegment : public PeerAction
+{
+  size_t index_;
+
+  RecordSegment( Peer peer, size_t index ) : PeerAction( peer ), index_( index ) {}
+  std::string description() const override
+  {
+    return "copy of segment #" + std::to_string( index_ ) + " sent to it is recorded";
+  }
+  void execute( PeerPair& pair ) const override { pair.recorded = round_trip( pair.queue( peer_ ).at( index_ ) ); }
+};
+
+struct ReplaySegment : public PeerAction
+{
+  using PeerAction::PeerAction;
+  std::string description() const override { return "the recorded segment is sent to it again"; }
+  void execute( PeerPair& pair ) const override { pair.queue( peer_ ).push_back( round_trip( *pair.recorded ) ); }
+};
+
+template<typename Num>
+struct ExpectPeerNumber : public ExpectNumber<PeerPair, Num>
+{
+  Peer peer_;
+
+  ExpectPeerNumber( Peer peer, Num value ) : ExpectNumber<PeerPair, Num>( value ), peer_( peer ) {}
+  Num value( const PeerPair& pair ) const override { return peer_value( pair.peer( peer_ ) ); }
+  virtual Num peer_value( const TCPPeer& peer ) const = 0;
+  constexpr std::string obj() const override { return peer_name( peer_ ); }
+};
+
+// Segments queued for the peer, not yet delivered
+struct ExpectSegmentsQueued : public ExpectNumber<PeerPair, size_t>
+{
+  Peer peer_;
+
+  ExpectSegmentsQueued( Peer peer, size_t value ) : ExpectNumber( value ), peer_( peer ) {}
+  std::string name() const override { return "number of segments sent to it"; }
+  size_t value( const PeerPair& pair ) const override { return pair.queue( peer_ ).size(); }
+  constexpr std::string obj() const override { return peer_name( peer_ ); }
+};
+
+struct ExpectLargestPayload : public ExpectNumber<PeerPair, size_t>
+{
+  Peer peer_;
+
+  ExpectLargestPayload( Peer peer, size_t value ) : ExpectNumber( value ), peer_( peer ) {}
+  std::string name() const override { return "largest payload sent to it"; }
+  size_t value( const PeerPair& pair ) const override
+  {
+    size_t largest = 0;
+    for ( const auto& msg : pair.queue( peer_ ) ) {
+      largest = std::max( largest, msg.sender->payload.size() );
+    }
+    return largest;
+  }
+  constexpr std::string obj() const override { return peer_name( peer_ ); }
+};
+
+// The latest segment queued for the peer
+struct ExpectLastSegment : public Expectation<PeerPair>
+{
+  Peer peer_;
+  std::optional<Wrap32> ackno_ {};
+  std::optional<uint32_t> window_size_ {};
+  std::optional<size_t> payload_size_ {};
+  std::optional<bool> has_window_scale_ {};
+  std::optional<bool> has_TSval_ {};
+  std::optional<size_t> sack_blocks_ {};
+
+  explicit ExpectLastSegment( Peer peer ) : peer_( peer ) {}
+
+  ExpectLastSegment& with_ackno( Wrap32 ackno )
+  {
+    ackno_ = ackno;
+    return *this;
+  }
+
+  ExpectLastSegment& with_window_size( uint32_t window_size )
+  {
+    window_size_ = window_size;
+    return *this;
+  }
+
+  ExpectLastSegment& with_payload_size( size_t payload_size )
+  {
+    payload_size_ = payload_size;
+    return *this;
+  }
+
+  ExpectLastSegment& with_window_scale( bool has_window_scale )
+  {
+    has_window_scale_ = has_window_scale;
+    return *this;
+  }
+
+  ExpectLastSegment& with_TSval( bool has_TSval )
+  {
+    has_TSval_ = has_TSval;
+    return *this;
+  }
+
+  ExpectLastSegment& with_sack_blocks( size_t sack_blocks )
+  {
+    sack_blocks_ = sack_blocks;
+    return *this;
+  }
+
+  std::string description() const override
+  {
+    std::ostringstream o;
+    o << "last segment sent to it has";
+    if ( ackno_.has_value() ) {
+      o << " ackno=" << ackno_.value();
+    }
+    if ( window_size_.has_value() ) {
+      o << " window=" << window_size_.value();
+    }
+    if ( payload_size_.has_value() ) {
+      o << " payload_len=" << payload_size_.value();
+    }
+    if ( has_window_scale_.has_value() ) {
+      o << ( has_window_scale_.value() ? " +WS" : " -WS" );
+    }
+    if ( has_TSval_.has_value() ) {
+      o << ( has_TSval_.value() ? " +TSval" : " -TSval" );
+    }
+    if ( sack_blocks_.has_value() ) {
+      o << " " << sack_blocks_.value() << " SACK blocks";
+    }
+    return o.str();
+  }
+
+  void execute( const PeerPair& pair ) const override
+  {
+    const auto& queue = pair.queue( peer_ );
+    if ( queue.empty() ) {
+      throw ExpectationViolation( "should have been sent a segment" );
+    }
+    const TCPMessage& msg = queue.back();
+    if ( ackno_.has_value() and msg.receiver->ackno != ackno_ ) {
+      throw ExpectationViolation( "ackno", std::optional { ackno_.value() }, msg.receiver->ackno );
+    }
+    if ( window_size_.has_value() and msg.receiver->window_size != window_size_.value() ) {
+      throw ExpectationViolation( "window_size", window_size_.value(), msg.receiver->window_size );
+    }
+    if ( payload_size_.has_value() and msg.sender->payload.size() != payload_size_.value() ) {
+      throw ExpectationViolation( "payload size", payload_size_.value(), msg.sender->payload.size() );
+    }
+    if ( has_window_scale_.has_value() and msg.sender->window_scale.has_value() != has_window_scale_.value() ) {
+      throw ExpectationViolation(
+        "window scale option", has_window_scale_.value(), msg.sender->window_scale.has_value() );
+    }
+    if ( has_TSval_.has_value() and msg.sender->TSval.has_value() != has_TSval_.value() ) {
+      throw ExpectationViolation( "timestamps option", has_TSval_.value(), msg.sender->TSval.has_value() );
+    }
+    if ( sack_blocks_.has_value() and msg.receiver->sack.size() != sack_blocks_.value() ) {
+      throw ExpectationViolation( "number of SACK blocks", sack_blocks_.value(), msg.receiver->sack.size() );
+    }
+  }
+
+  constexpr std::string obj() const override { return peer_name( peer_ ); }
+};
+
+struct ExpectInFlightBetween : public Expectation<PeerPair>
+{
+  Peer peer_;
+  uint64_t min_, max_;
+
+  ExpectInFlightBetween( Peer peer, uint64_t min, uint64_t max ) // NOLINT(*-swappable-*)
+    : peer_( peer ), min_( min ), max_( max )
+  {}
+
+  std::string description() const override
+  {
+    return "sequence_numbers_in_flight between " + std::to_string( min_ ) + " and " + std::to_string( max_ );
+  }
+
+  void execute( const PeerPair& pair ) const override
+  {
+    const uint64_t in_flight = pair.peer( peer_ ).sender().sequence_numbers_in_flight();
+    if ( in_flight < min_ or in_flight > max_ ) {
+      throw ExpectationViolation( "had " + std::to_string( in_flight ) + " sequence numbers in flight" );
+    }
+  }
+
+  constexpr std::string obj() const override { return peer_name( peer_ ); }
+};
+
+struct ExpectPeerInFlight : public ExpectPeerNumber<uint64_t>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string name() const override { return "sequence_numbers_in_flight"; }
+  uint64_t peer_value( const TCPPeer& peer ) const override { return peer.sender().sequence_numbers_in_flight(); }
+};
+
+struct ExpectPeerCongestionWindow : public ExpectPeerNumber<uint64_t>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string name() const override { return "congestion_window"; }
+  uint64_t peer_value( const TCPPeer& peer ) const override { return peer.sender().congestion_window(); }
+};
+
+struct ExpectPeerSmoothedRTT : public ExpectPeerNumber<std::optional<uint64_t>>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string name() const override { return "smoothed_rtt"; }
+  std::optional<uint64_t> peer_value( const TCPPeer& peer ) const override { return peer.sender().smoothed_rtt(); }
+};
+
+struct ExpectPeerWindowScale : public ExpectPeerNumber<uint8_t>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string name() const override { return "receiver window_scale"; }
+  uint8_t peer_value( const TCPPeer& peer ) const override { return peer.receiver().window_scale(); }
+};
+
+struct ExpectInbound : public ExpectPeerNumber<std::string>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string name() const override { return "inbound stream contents"; }
+  std::string peer_value( const TCPPeer& peer ) const override
+  {
+    return std::string { peer.receiver().reader().peek() };
+  }
+};
+
+struct ExpectSegmentsReceived : public ExpectPeerNumber<uint64_t>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string name() const override { return "ack_stats().segments_received"; }
+  uint64_t peer_value( const TCPPeer& peer ) const override { return peer.ack_stats().segments_received; }
+};
+
+struct ExpectPureAcksSent : public ExpectPeerNumber<uint64_t>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string name() const override { return "ack_stats().pure_acks_sent"; }
+  uint64_t peer_value( const TCPPeer& peer ) const override { return peer.ack_stats().pure_acks_sent; }
+};
+
+struct ExpectDelayedAcksSent : public ExpectPeerNumber<uint64_t>
+{
+  using ExpectPeerNumber::ExpectPeerNumber;
+  std::string name() const override { return "ack_stats().delayed_acks_sent"; }
+  uint64_t peer_value( const TCPPeer& peer ) const override { return peer.ack_stats().delayed_acks_sent; }
+};
@@ -0,0 +1,115 @@
+#include "tcp_config.hh"
+#include "tcp_sender.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+// Push data through a TCPSender whose peer acknowledges every segment as soon as it is sent, or (with sparse ACKs)
+// only once the send buffer is full, so that segments are cut from deep inside a buffer of many writes.
+void speed_test( fstream& debug_output,
+                 const size_t input_len,   // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t write_size,  // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
+                 const ByteStream::Storage storage,
+                 const bool sparse_acks = false )
+{
+  // Generate the data to be written
+  const string data = [&random_seed, &input_len] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  const Wrap32 isn { static_cast<uint32_t>( random_seed ) };
+  const uint64_t capacity = sparse_acks ? 1 << 20 : TCPConfig::DEFAULT_CAPACITY;
+  const uint32_t window_size = sparse_acks ? capacity : UINT16_MAX;
+  TCPSender sender { ByteStream { capacity, storage }, isn, TCPConfig::TIMEOUT_DFLT };
+
+  string output_data;
+  output_data.reserve( data.size() );
+  uint64_t next_seqno = 0;
+  bool finished = false;
+  const auto transmit = [&]( const TCPSenderMessage& msg ) {
+    output_data += msg.payload;
+    next_seqno += msg.sequence_length();
+    finished |= msg.FIN;
+  };
+
+  const auto start_time = steady_clock::now();
+  size_t written = 0;
+  while ( !finished ) {
+    if ( written < data.size() ) {
+      const size_t len = min( { write_size, data.size() - written, sender.writer().available_capacity() } );
+      sender.writer().push( data.substr( written, len ) );
+      written += len;
+    } else if ( !sender.writer().is_closed() ) {
+      sender.writer().close();
+    }
+
+    sender.push( transmit );
+    if ( !sparse_acks || !sender.writer().available_capacity() || written == data.size() ) {
+      sender.receive( { .ackno = Wrap32::wrap( next_seqno, isn ), .window_size = window_size, .RST = false } );
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( data != output_data ) {
+    throw runtime_error( "Mismatch between data written and sent" );
+  }
+
+  auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  auto bytes_per_second = static_cast<double>( input_len ) / test_duration.count();
+  auto bits_per_second = 8 * bytes_per_second;
+  auto gigabits_per_second = bits_per_second / 1e9;
+
+  string storage_name = storage == ByteStream::Storage::Chunked ? "chunked" : "ring";
+  if ( sparse_acks ) {
+    storage_name += ", sparse ACKs";
+  }
+  cout << "TCPSender (" << storage_name << ") with write_size=" << write_size << " reached " << fixed
+       << setprecision( 2 ) << gigabits_per_second << " Gbit/s.\n";
+
+  auto write_s = to_string( write_size );
+  const string fill( 6 - write_s.size(), ' ' );
+  debug_output << "         TCPSender throughput (" << storage_name << ", push length " << write_s << "):" << fill
+               << fixed << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s\n";
+
+  if ( gigabits_per_second < 0.1 ) {
+    throw runtime_error( "TCPSender did not meet minimum speed of 0.1 Gbit/s" );
+  }
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  speed_test( debug_output, 1e7, 1500, 789, ByteStream::Storage::Ring );
+  speed_test( debug_output, 1e7, 65536, 789, ByteStream::Storage::Ring );
+  speed_test( debug_output, 1e7, 100, 789, ByteStream::Storage::Chunked );
+  speed_test( debug_output, 1e7, 1500, 789, ByteStream::Storage::Chunked );
+  speed_test( debug_output, 1e7, 100, 789, ByteStream::Storage::Chunked, true );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include "tcp_config.hh"
+#include "tcp_peer_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      TCPReceiverMessage ack {
+        .ackno = Wrap32 { 77 }, .window_size = 5000, .RST = false, .sack = {}, .TSecr = 1234 };
+      for ( uint32_t i = 0; i < TCPReceiverMessage::MAX_SACK_BLOCKS; i++ ) {
+        ack.sack.push_back( { Wrap32 { 100 + 20 * i }, Wrap32 { 110 + 20 * i } } );
+      }
+      TCPSegmentTestHarness test { "timestamps survive the round trip",
+                                   { .seqno = Wrap32 { 1000 }, .payload = "hello", .TSval = 0xDEADBEEF },
+                                   ack };
+      test.execute( RoundTrip {} );
+      test.execute( ExpectTSval { 0xDEADBEEF } );
+      test.execute( ExpectTSecr { 1234 } );
+      test.execute( ExpectSACKBlocks { 3 } ); // timestamps leave room for three SACK blocks
+      test.execute( ExpectPayload { "hello" } );
+    }
+
+    {
+      TCPSegmentTestHarness test {
+        "TSecr only counts with an ACK",
+        { .seqno = Wrap32 { 1000 }, .payload = "hello", .TSval = 0xDEADBEEF },
+        { .ackno = {}, .window_size = 5000, .RST = false, .sack = {}, .TSecr = 1234 } };
+      test.execute( RoundTrip {} );
+      test.execute( ExpectTSecr { nullopt } );
+    }
+
+    // Each peer's clock runs 1 ms before it receives a delivery
+    for ( const bool server_timestamps : { true, false } ) {
+      TCPConfig client_cfg, server_cfg;
+      client_cfg.timestamps = true;
+      client_cfg.rt_timeout_min = 1;
+      server_cfg.timestamps = server_timestamps;
+
+      TCPPeerTestHarness test { server_timestamps ? "both peers stamp their segments"
+                                                  : "no stamps unless both SYNs carried them",
+                                client_cfg,
+                                server_cfg };
+      test.execute( Write { Peer::Client } );
+      test.execute( TickPeer { Peer::Server, 1 } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( TickPeer { Peer::Client, 1 } );
+      test.execute( Deliver { Peer::Client } );
+      test.execute( Write { Peer::Client, "hello" } );
+      test.execute( ExpectLastSegment { Peer::Server }.with_TSval( server_timestamps ) );
+      test.execute( TickPeer { Peer::Server, 1 } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( TickPeer { Peer::Client, 1 } );
+      test.execute( Deliver { Peer::Client } );
+      test.execute( ExpectInbound { Peer::Server, "hello" } );
+      test.execute( ExpectPeerSmoothedRTT { Peer::Client, 1 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+#include "tcp_config.hh"
+#include "tcp_peer_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      TCPSegmentTestHarness test {
+        "window scale option survives the round trip",
+        { .seqno = Wrap32 { 1000 }, .SYN = true, .SACK_permitted = true, .window_scale = 7 },
+        { .ackno = Wrap32 { 77 },
+          .window_size = 5000,
+          .RST = false,
+          .sack = { { Wrap32 { 80 }, Wrap32 { 90 } } } } };
+      test.execute( RoundTrip {} );
+      test.execute( ExpectWindowScaleOption { 7 } );
+      test.execute( ExpectSACKPermittedOption { true } );
+      test.execute( ExpectAdvertisedWindow { 5000 } );
+      test.execute( ExpectSACKBlocks { 1 } );
+    }
+
+    {
+      TCPSegmentTestHarness test {
+        "no window scale option unless set", { .seqno = Wrap32 { 1000 } }, { .ackno = Wrap32 { 77 } } };
+      test.execute( RoundTrip {} );
+      test.execute( ExpectWindowScaleOption { nullopt } );
+    }
+
+    // The window on the SYN is unscaled, so the first flight is capped; the ACKs for it carry the scaled window.
+    for ( const bool window_scale : { true, false } ) {
+      TCPConfig cfg;
+      cfg.recv_capacity = 1'000'000;
+      cfg.send_capacity = 1'000'000;
+      cfg.window_scale = window_scale;
+
+      TCPPeerTestHarness test { window_scale ? "window scaling lets more than 64 KiB fly"
+                                             : "without window scaling, the window is capped at 64 KiB",
+                                cfg,
+                                cfg };
+      test.execute( Handshake {} );
+      test.execute( ExpectPeerWindowScale { Peer::Server, window_scale ? uint8_t { 4 } : uint8_t { 0 } } );
+      test.execute( Write { Peer::Client, string( 500'000, 'x' ) } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( Deliver { Peer::Client } );
+      if ( window_scale ) {
+        test.execute( ExpectInFlightBetween { Peer::Client, UINT16_MAX + 1, cfg.recv_capacity } );
+      } else {
+        test.execute( ExpectInFlightBetween { Peer::Client, 1, UINT16_MAX } );
+      }
+    }
+
+    // A SYN-ACK carries the option only in reply to a SYN that did, and the server's windows stay unscaled.
+    {
+      TCPConfig client_cfg, server_cfg;
+      server_cfg.window_scale = true;
+      server_cfg.recv_capacity = 1001;
+      server_cfg.recv_capacity_max = 1'000'000;
+
+      TCPPeerTestHarness test { "no window scaling when the client does not offer it", client_cfg, server_cfg };
+      test.execute( Write { Peer::Client } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( ExpectLastSegment { Peer::Client }.with_window_scale( false ).with_window_size( 1001 ) );
+      test.execute( Deliver { Peer::Client } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( ExpectPeerWindowScale { Peer::Server, 0 } );
+      test.execute( Write { Peer::Client, "hello" } );
+      test.execute( Deliver { Peer::Server } );
+      test.execute( ExpectLastSegment { Peer::Client }.with_window_size( 996 ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,238 @@
+#include "buffer_pool.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t SLAB_SIZE = 64 * 1024;          // small blocks are carved out of slabs of this size
+constexpr size_t CACHE_LIMIT_BYTES = 256 * 1024; // per size class, per thread
+constexpr size_t RETAINED_FREE_SLABS = 1;        // per size class: wholly free slabs the depot keeps
+
+size_t size_class( size_t size )
+{
+  return bit_width( max( size, BufferPool::MIN_BLOCK_SIZE ) - 1 ) - bit_width( BufferPool::MIN_BLOCK_SIZE - 1 );
+}
+
+size_t block_size( size_t size_class )
+{
+  return BufferPool::MIN_BLOCK_SIZE << size_class;
+}
+
+size_t slab_size( size_t size_class )
+{
+  return max( SLAB_SIZE, block_size( size_class ) );
+}
+
+// How many free blocks of a size class a thread may keep before giving half of them back to the depot
+size_t cache_limit( size_t size_class )
+{
+  return max<size_t>( 2, CACHE_LIMIT_BYTES / block_size( size_class ) );
+}
+
+using FreeLists = array<vector<void*>, BufferPool::NUM_SIZE_CLASSES>;
+
+class ThreadCache;
+
+struct Depot
+{
+  mutex lock {};
+  FreeLists free {};
+
+  // Per size class: each slab (by its address) with how many of its blocks are on the depot's free list, and
+  // how many slabs are wholly free
+  array<map<char*, size_t>, BufferPool::NUM_SIZE_CLASSES> slabs {};
+  array<size_t, BufferPool::NUM_SIZE_CLASSES> free_slabs {};
+  uint64_t pool_bytes {};
+  uint64_t high_water_bytes {};
+  uint64_t retired_hits {};   // counters of threads that have exited
+  uint64_t retired_misses {};
+  vector<const ThreadCache*> caches {};
+
+  // Move up to `count` free blocks of a size class to `out`, carving a new slab if there are none.
+  // Returns true if new memory had to come from the heap.
+  bool take( size_t size_class, size_t count, vector<void*>& out )
+  {
+    const lock_guard guard { lock };
+    auto& list = free[size_class];
+    bool carved = false;
+    if ( list.empty() ) {
+      const size_t size = block_size( size_class );
+      const size_t bytes = slab_size( size_class );
+      auto* slab = static_cast<char*>( ::operator new( bytes ) );
+      for ( size_t offset = 0; offset + size <= bytes; offset += size ) {
+        list.push_back( slab + offset );
+      }
+      slabs[size_class].emplace( slab, bytes / size );
+      free_slabs[size_class]++;
+      pool_bytes += bytes;
+      high_water_bytes = max( high_water_bytes, pool_bytes );
+      carved = true;
+    }
+    const size_t n = min( count, list.size() );
+    for ( auto it = list.end() - static_cast<ptrdiff_t>( n ); it != list.end(); ++it ) {
+      if ( slab_of( size_class, *it )->second-- == blocks_per_slab( size_class ) ) {
+        free_slabs[size_class]--;
+      }
+    }
+    out.insert( out.end(), list.end() - static_cast<ptrdiff_t>( n ), list.end() );
+    list.resize( list.size() - n );
+    return carved;
+  }
+
+  // Take back the last `count` blocks of `blocks`, and return slabs that became wholly free to the heap
+  void give( size_t size_class, size_t count, vector<void*>& blocks )
+  {
+    const lock_guard guard { lock };
+    for ( auto it = blocks.end() - static_cast<ptrdiff_t>( count ); it != blocks.end(); ++it ) {
+      const auto slab = slab_of( size_class, *it );
+      free[size_class].push_back( *it );
+      if ( ++slab->second == blocks_per_slab( size_class ) ) {
+        if ( free_slabs[size_class] < RETAINED_FREE_SLABS ) {
+          free_slabs[size_class]++;
+        } else {
+          release( size_class, slab );
+        }
+      }
+    }
+    blocks.resize( blocks.size() - count );
+  }
+
+private:
+  static size_t blocks_per_slab( size_t size_class ) { return slab_size( size_class ) / block_size( size_class ); }
+
+  map<char*, size_t>::iterator slab_of( size_t size_class, void* block )
+  {
+    return prev( slabs[size_class].upper_bound( static_cast<char*>( block ) ) );
+  }
+
+  void release( size_t size_class, map<char*, size_t>::iterator slab )
+  {
+    char* const begin = slab->first;
+    char* const end = begin + slab_size( size_class );
+    erase_if( free[size_class], [&]( void* block ) {
+      return static_cast<char*>( block ) >= begin and static_cast<char*>( block ) < end;
+    } );
+    ::operator delete( begin );
+    pool_bytes -= slab_size( size_class );
+    slabs[size_class].erase( slab );
+  }
+};
+
+Depot& depot()
+{
+  static auto* instance = new Depot; // never destroyed: threads may still free blocks during shutdown
+  return *instance;
+}
+
+class ThreadCache
+{
+public:
+  FreeLists free {};
+
+  // Only the owning thread writes these (no read-modify-write needed); stats() may read them from any thread.
+  atomic<uint64_t> hits { 0 };
+  atomic<uint64_t> misses { 0 };
+
+  ThreadCache()
+  {
+    const lock_guard guard { depot().lock };
+    depot().caches.push_back( this );
+  }
+
+  ~ThreadCache()
+  {
+    for ( size_t c = 0; c < BufferPool::NUM_SIZE_CLASSES; c++ ) {
+      depot().give( c, free[c].size(), free[c] );
+    }
+    const lock_guard guard { depot().lock };
+    depot().retired_hits += hits.load( memory_order_relaxed );
+    depot().retired_misses += misses.load( memory_order_relaxed );
+    erase( depot().caches, this );
+    alive = false;
+  }
+
+  ThreadCache( const ThreadCache& ) = delete;
+  ThreadCache& operator=( const ThreadCache& ) = delete;
+  ThreadCache( ThreadCache&& ) = delete;
+  ThreadCache& operator=( ThreadCache&& ) = delete;
+
+  static void count( atomic<uint64_t>& counter )
+  {
+    counter.store( counter.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+  }
+
+  static thread_local bool alive; // false once this thread's cache is destroyed (during thread exit)
+};
+
+thread_local bool ThreadCache::alive = true;
+thread_local ThreadCache cache;
+
+} // namespace
+
+void* BufferPool::allocate( size_t size )
+{
+  if ( size > MAX_BLOCK_SIZE or not ThreadCache::alive ) {
+    if ( ThreadCache::alive ) {
+      ThreadCache::count( cache.misses );
+    }
+    return ::operator new( size );
+  }
+
+  const size_t c = size_class( size );
+  auto& list = cache.free[c];
+  if ( list.empty() ) {
+    const bool carved = depot().take( c, cache_limit( c ) / 2 + 1, list );
+    ThreadCache::count( carved ? cache.misses : cache.hits );
+  } else {
+    ThreadCache::count( cache.hits );
+  }
+
+  void* block = list.back();
+  list.pop_back();
+  return block;
+}
+
+void BufferPool::deallocate( void* ptr, size_t size )
+{
+  if ( size > MAX_BLOCK_SIZE ) {
+    ::operator delete( ptr );
+    return;
+  }
+
+  const size_t c = size_class( size );
+  if ( not ThreadCache::alive ) {
+    vector<void*> one { ptr };
+    depot().give( c, 1, one );
+    return;
+  }
+
+  auto& list = cache.free[c];
+  list.push_back( ptr );
+  if ( list.size() > cache_limit( c ) ) {
+    depot().give( c, list.size() / 2, list );
+  }
+}
+
+BufferPool::Stats BufferPool::stats()
+{
+  auto& d = depot();
+  const lock_guard guard { d.lock };
+  Stats ret { .hits = d.retired_hits,
+              .misses = d.retired_misses,
+              .pool_bytes = d.pool_bytes,
+              .high_water_bytes = d.high_water_bytes };
+  for ( const auto* c : d.caches ) {
+    ret.hits += c->hits.load( memory_order_relaxed );
+    ret.misses += c->misses.load( memory_order_relaxed );
+  }
+  return ret;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// BufferPool: a process-wide allocator of fixed-size blocks in power-of-two size classes (64 B to 1 MiB).
+//
+// Each thread keeps a small cache of free blocks per size class, so most allocations and frees take no lock.
+// A cache refills from (and overflows into) a shared depot, which carves new blocks out of slabs from the heap.
+// Once every block of a slab is back in the depot, the slab returns to the heap (the depot keeps one such slab
+// per size class, to absorb churn). Requests larger than MAX_BLOCK_SIZE go straight to the heap.
+class BufferPool
+{
+public:
+  static constexpr size_t MIN_BLOCK_SIZE = 64;
+  static constexpr size_t MAX_BLOCK_SIZE = size_t { 1 } << 20;
+  static constexpr size_t NUM_SIZE_CLASSES = 15; // 64 B, 128 B, ..., 1 MiB
+
+  struct Stats
+  {
+    uint64_t hits {};            // allocations served from a thread cache or the depot
+    uint64_t misses {};          // allocations that needed new memory from the heap (including oversized ones)
+    uint64_t pool_bytes {};      // memory currently held by the pool's slabs
+    uint64_t high_water_bytes {}; // most memory that the pool's slabs have ever held
+  };
+
+  static void* allocate( size_t size );
+  static void deallocate( void* ptr, size_t size );
+
+  // Totals over all threads (including ones that have exited)
+  static Stats stats();
+};
+
+// A standard-library allocator that draws from the BufferPool, e.g. for node-based containers and buffers.
+template<typename T>
+class PoolAllocator
+{
+  static_assert( alignof( T ) <= alignof( std::max_align_t ), "PoolAllocator: over-aligned type" );
+
+public:
+  using value_type = T;
+
+  PoolAllocator() = default;
+
+  template<typename U>
+  PoolAllocator( const PoolAllocator<U>& /*unused*/ ) // NOLINT(*-explicit-*)
+  {}
+
+  T* allocate( size_t n ) { return static_cast<T*>( BufferPool::allocate( n * sizeof( T ) ) ); }
+  void deallocate( T* ptr, size_t n ) { BufferPool::deallocate( ptr, n * sizeof( T ) ); }
+
+  template<typename U>
+  bool operator==( const PoolAllocator<U>& /*unused*/ ) const
+  {
+    return true;
+  }
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "buffer_pool.hh"
 #include "ref.hh"
 
 #include <concepts>
@@ -17,7 +18,7 @@ class Parser
   class BufferList
   {
     uint64_t size_ {};
-    std::deque<Ref<std::string>> buffer_ {};
+    std::deque<Ref<std::string>, PoolAllocator<Ref<std::string>>> buffer_ {};
     uint64_t skip_ {};
 
   public:
@@ -0,0 +1,150 @@
+#include "spill_file.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+int make_temporary_file()
+{
+  const char* dir = getenv( "TMPDIR" ); // NOLINT(*-mt-unsafe)
+  const string directory = dir ? dir : "/tmp";
+
+  const int fd = ::open( directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600 ); // NOLINT(*-vararg)
+  if ( fd >= 0 ) {
+    return fd;
+  }
+
+  // Filesystem without O_TMPFILE support: create a named file and unlink it right away.
+  string name = directory + "/minnow-spill-XXXXXX";
+  const int named_fd = CheckSystemCall( "mkstemp", ::mkstemp( name.data() ) );
+  CheckSystemCall( "unlink", ::unlink( name.c_str() ) );
+  return named_fd;
+}
+
+// The largest page-aligned range inside [offset, offset+len), as (offset, length)
+pair<uint64_t, uint64_t> whole_pages( uint64_t offset, uint64_t len )
+{
+  const uint64_t page_size = SpillFile::page_size();
+  const uint64_t begin = ( offset + page_size - 1 ) / page_size * page_size;
+  const uint64_t end = ( offset + len ) / page_size * page_size;
+  return { begin, end > begin ? end - begin : 0 };
+}
+
+} // namespace
+
+uint64_t SpillFile::page_size()
+{
+  static const uint64_t size = sysconf( _SC_PAGESIZE );
+  return size;
+}
+
+SpillFile::SpillFile( uint64_t size ) : fd_( make_temporary_file() ), size_( size )
+{
+  CheckSystemCall( "ftruncate", ::ftruncate( fd_.fd_num(), static_cast<off_t>( size_ ) ) );
+  map();
+}
+
+SpillFile::~SpillFile()
+{
+  unmap();
+}
+
+SpillFile::SpillFile( const SpillFile& other ) : SpillFile( other.size_ )
+{
+  // Copy only the data extents; holes (never written, or released) stay holes.
+  off_t offset = 0;
+  while ( true ) {
+    const off_t data_begin = ::lseek( other.fd_.fd_num(), offset, SEEK_DATA );
+    if ( data_begin < 0 ) {
+      break; // ENXIO: no more data
+    }
+    const off_t data_end = CheckSystemCall( "lseek", ::lseek( other.fd_.fd_num(), data_begin, SEEK_HOLE ) );
+    copy( other.data_ + data_begin, other.data_ + data_end, data_ + data_begin );
+    offset = data_end;
+  }
+}
+
+SpillFile& SpillFile::operator=( const SpillFile& other )
+{
+  if ( this != &other ) {
+    *this = SpillFile { other };
+  }
+  return *this;
+}
+
+SpillFile::SpillFile( SpillFile&& other ) noexcept
+  : fd_( move( other.fd_ ) ), size_( other.size_ ), data_( exchange( other.data_, nullptr ) )
+{}
+
+SpillFile& SpillFile::operator=( SpillFile&& other ) noexcept
+{
+  if ( this != &other ) {
+    unmap();
+    fd_ = move( other.fd_ );
+    size_ = other.size_;
+    data_ = exchange( other.data_, nullptr );
+  }
+  return *this;
+}
+
+void SpillFile::map()
+{
+  if ( !size_ ) {
+    return;
+  }
+  void* const addr = ::mmap( nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_.fd_num(), 0 );
+  if ( addr == MAP_FAILED ) { // NOLINT(*-cstyle-cast)
+    throw unix_error { "mmap" };
+  }
+  data_ = static_cast<char*>( addr );
+}
+
+void SpillFile::unmap()
+{
+  if ( data_ ) {
+    ::munmap( data_, size_ );
+    data_ = nullptr;
+  }
+}
+
+void SpillFile::page_out( uint64_t offset, uint64_t len )
+{
+  const auto [begin, length] = whole_pages( offset, len );
+  if ( !length ) {
+    return;
+  }
+
+  // Write the pages out, unmap them from this process, then drop them (now clean) from the page cache.
+  CheckSystemCall( "sync_file_range",
+                   ::sync_file_range( fd_.fd_num(),
+                                      static_cast<off_t>( begin ),
+                                      static_cast<off_t>( length ),
+                                      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE
+                                        | SYNC_FILE_RANGE_WAIT_AFTER ) );
+  CheckSystemCall( "madvise", ::madvise( data_ + begin, length, MADV_DONTNEED ) );
+  ::posix_fadvise( fd_.fd_num(), static_cast<off_t>( begin ), static_cast<off_t>( length ), POSIX_FADV_DONTNEED );
+}
+
+void SpillFile::release( uint64_t offset, uint64_t len )
+{
+  const auto [begin, length] = whole_pages( offset, len );
+  if ( !length ) {
+    return;
+  }
+
+  CheckSystemCall( "fallocate",
+                   ::fallocate( fd_.fd_num(),
+                                FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                                static_cast<off_t>( begin ),
+                                static_cast<off_t>( length ) ) );
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <cstdint>
+
+// An anonymous temporary file mapped into memory.
+// The file is sparse: disk space is only used for bytes that have been written and not released,
+// and the kernel can keep most of the mapping on disk instead of in RAM.
+class SpillFile
+{
+public:
+  // Create an unlinked temporary file of `size` bytes (in $TMPDIR, or /tmp) and map it
+  explicit SpillFile( uint64_t size );
+  ~SpillFile();
+
+  // Copying creates a new temporary file with the same contents (only the allocated parts are copied)
+  SpillFile( const SpillFile& other );
+  SpillFile& operator=( const SpillFile& other );
+  SpillFile( SpillFile&& other ) noexcept;
+  SpillFile& operator=( SpillFile&& other ) noexcept;
+
+  char* data() { return data_; }
+  const char* data() const { return data_; }
+  uint64_t size() const { return size_; }
+
+  static uint64_t page_size();
+
+  // Write [offset, offset+len) back to disk and drop those pages from memory (they remain readable)
+  void page_out( uint64_t offset, uint64_t len );
+
+  // Discard the contents of [offset, offset+len), freeing its memory and disk space (reads back as zeros)
+  void release( uint64_t offset, uint64_t len );
+
+private:
+  FileDescriptor fd_;
+  uint64_t size_;
+  char* data_ {};
+
+  void map();
+  void unmap();
+};
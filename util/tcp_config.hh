@@ -1,6 +1,7 @@
 #pragma once
 
 #include "address.hh"
+#include "congestion_control.hh"
 #include "wrapping_integers.hh"
 
 #include <cstddef>
@@ -14,11 +15,28 @@ public:
   static constexpr size_t MAX_PAYLOAD_SIZE = 1000;  //!< Conservative max payload size for real Internet
   static constexpr uint16_t TIMEOUT_DFLT = 1000;    //!< Default re-transmit timeout is 1 second
   static constexpr unsigned MAX_RETX_ATTEMPTS = 8;  //!< Maximum re-transmit attempts before giving up
+  static constexpr uint64_t RTO_MAX = 60000;        //!< Upper bound for an adaptive re-transmit timeout
+  static constexpr size_t IPV4_TCP_HEADERS = 40;    //!< IPv4 and TCP headers without options, per datagram
 
   uint16_t rt_timeout = TIMEOUT_DFLT;      //!< Initial value of the retransmission timeout, in milliseconds
+  uint16_t rt_timeout_min = 0;             //!< Lower bound for an RTO measured from RTTs (0: don't measure)
   size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes
+  size_t recv_capacity_max = 0;            //!< Autotuning ceiling for recv_capacity (off if not above it)
   size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes
+  size_t mtu = 0;                          //!< Interface MTU; the MSS is what fits (0: MAX_PAYLOAD_SIZE)
   Wrap32 isn { 137 };                      //!< Default initial sequence number
+  bool sack = false;                       //!< Offer selective acknowledgments (RFC 2018)
+  bool fast_retransmit = false;            //!< Retransmit on three duplicate ACKs (RFC 5681/6582)
+  bool window_scale = false;               //!< Offer window scaling (RFC 7323) for windows above 64 KiB
+  bool timestamps = false;                 //!< Offer timestamps (RFC 7323) to time every ACK and apply PAWS
+  uint16_t ack_delay = 0;                  //!< Delay ACKs of in-order data up to this many ms (0: ACK each)
+  bool pacing = false;                     //!< Pace new segments through a token bucket instead of bursting
+  uint64_t pacing_rate = 0;                //!< Pacing rate in bytes/s (0: derived from the measured rate/RTT)
+  double pacing_gain = 1.25;               //!< Multiplies a derived pacing rate, so that it can still grow
+  uint16_t pacing_burst = 2;               //!< Token bucket depth, in full-sized segments
+
+  //! Congestion control algorithm of the sender
+  CongestionControl::Algorithm congestion_control = CongestionControl::Algorithm::None;
 };
 
 //! Config for classes derived from FdAdapter
@@ -92,6 +92,10 @@ private:
   bool _outbound_shutdown { false }; //!< Has the owner shut down the outbound data to the TCP connection?
 
   bool _fully_acked { false }; //!< Has the outbound data been fully acknowledged by the peer?
+
+  bool _outbound_writable { false }; //!< Is the outbound stream below its low watermark (and open)?
+
+  bool _inbound_readable { false }; //!< Does the inbound stream hold at least its high watermark's bytes?
 };
 
 using TCPOverIPv4MinnowSocket = TCPMinnowSocket<TCPOverIPv4OverTunFdAdapter>;
@@ -61,6 +61,13 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
 {
   _tcp.emplace( config );
 
+  // Only read more from the application once the outbound buffer has drained to half full
+  _tcp->outbound_writer().set_low_watermark( config.send_capacity / 2 );
+
+  // Track the streams' readiness as they report crossing their watermarks, rather than re-checking every loop
+  _tcp->outbound_writer().on_writable_change( [&]( bool writable ) { _outbound_writable = writable; } );
+  _tcp->inbound_reader().on_readable_change( [&]( bool readable ) { _inbound_readable = readable; } );
+
   // Set up the event loop
 
   // There are three events to handle:
@@ -100,10 +107,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     _thread_data,
     Direction::In,
     [&] {
-      std::string data;
-      data.resize( _tcp->outbound_writer().available_capacity() );
-      _thread_data.read( data );
-      _tcp->outbound_writer().push( move( data ) );
+      _tcp->outbound_writer().push_from( _thread_data );
 
       if ( _thread_data.eof() ) {
         _tcp->outbound_writer().close();
@@ -119,8 +123,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
       _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
     },
     [&] {
-      return ( _tcp->active() ) and ( not _outbound_shutdown )
-             and ( _tcp->outbound_writer().available_capacity() > 0 );
+      return ( _tcp->active() ) and ( not _outbound_shutdown ) and ( _outbound_writable );
     },
     [&] {
       _tcp->outbound_writer().close();
@@ -138,14 +141,10 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     Direction::Out,
     [&] {
       Reader& inbound = _tcp->inbound_reader();
-      // Write from the inbound_stream into
-      // the pipe, handling the possibility of a partial
-      // write (i.e., only pop what was actually written).
-      if ( inbound.bytes_buffered() ) {
-        const std::string_view buffer = inbound.peek();
-        const auto bytes_written = _thread_data.write( buffer );
-        inbound.pop( bytes_written );
-      }
+      // Write everything buffered in the inbound_stream into
+      // the pipe with one writev (pop_into only pops what was
+      // actually written, in case of a partial write).
+      inbound.pop_into( _thread_data );
 
       if ( inbound.is_finished() or inbound.has_error() ) {
         _thread_data.shutdown( SHUT_WR );
@@ -157,7 +156,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
       }
     },
     [&] {
-      return _tcp->inbound_reader().bytes_buffered()
+      return _inbound_readable
              or ( ( _tcp->inbound_reader().is_finished() or _tcp->inbound_reader().has_error() )
                   and not _inbound_shutdown );
     },
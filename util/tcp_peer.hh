@@ -7,6 +7,8 @@
 #include "tcp_sender.hh"
 #include "tcp_sender_message.hh"
 
+#include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <optional>
 
@@ -18,7 +20,36 @@ class TCPPeer
   }
 
 public:
-  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg ) {}
+  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg )
+  {
+    sender_.set_congestion_control( cfg_.congestion_control );
+    sender_.offer_mss( local_mss() );
+    sender_.set_max_payload_size( send_mss( false ) );
+    if ( cfg_.recv_capacity_max > cfg_.recv_capacity ) {
+      receiver_.enable_autotuning( cfg_.recv_capacity_max );
+    }
+    if ( cfg_.rt_timeout_min ) {
+      sender_.enable_adaptive_rto( cfg_.rt_timeout_min, TCPConfig::RTO_MAX );
+    }
+    if ( cfg_.sack ) {
+      sender_.enable_sack();
+    }
+    if ( cfg_.fast_retransmit ) {
+      sender_.enable_fast_retransmit();
+    }
+    if ( cfg_.pacing ) {
+      sender_.enable_pacing( cfg_.pacing_rate, cfg_.pacing_gain, cfg_.pacing_burst );
+    }
+    if ( cfg_.timestamps ) {
+      sender_.enable_timestamps();
+      receiver_.enable_timestamps();
+    }
+    if ( cfg_.window_scale ) {
+      const auto shift = window_shift_for( std::max( cfg_.recv_capacity, cfg_.recv_capacity_max ) );
+      sender_.offer_window_scale( shift );
+      receiver_.enable_window_scale( shift );
+    }
+  }
 
   Writer& outbound_writer() { return sender_.writer(); }
   Reader& inbound_reader() { return receiver_.reader(); }
@@ -32,6 +63,14 @@ public:
   {
     cumulative_time_ += t;
     sender_.tick( t, make_send( transmit ) );
+    receiver_.tick( t );
+
+    // Send a delayed ACK once its timer runs out, or at once if the application opened up the window meanwhile
+    const bool timer_expired = ack_deadline_.has_value() and cumulative_time_ >= ack_deadline_.value();
+    if ( timer_expired or window_opened() ) {
+      ack_stats_.delayed_acks_sent += timer_expired;
+      send( sender_.make_empty_message(), transmit );
+    }
   }
   bool has_ackno() const { return receiver_.send().ackno.has_value(); }
 
@@ -56,19 +95,51 @@ public:
     // Record time in case this peer has to linger after streams finish.
     time_of_last_receipt_ = cumulative_time_;
 
-    // If SenderMessage occupies a sequence number, make sure to reply.
-    need_send_ |= ( msg.sender->sequence_length() > 0 );
-
     // If SenderMessage is a "keep-alive" (with intentionally invalid seqno), make sure to reply.
     // (N.B. orthodox TCP rules require a reply on any unacceptable segment.)
     const auto our_ackno = receiver_.send().ackno;
     need_send_ |= ( our_ackno.has_value() and msg.sender->seqno + 1 == our_ackno.value() );
 
+    // If SenderMessage occupies a sequence number, make sure to reply. With delayed ACKs, a segment that arrives
+    // in order, with no gap to fill, can wait to share its ACK with the next one (RFC 1122, RFC 5681).
+    const bool occupies_seqno = msg.sender->sequence_length() > 0;
+    const bool delayable = cfg_.ack_delay and our_ackno.has_value() and msg.sender->seqno == our_ackno.value()
+                           and not( msg.sender->SYN or msg.sender->FIN or msg.sender->RST )
+                           and not receiver_.reassembler().has_pending();
+
+    // Window scaling is on once both SYNs carried the option. The window in a SYN is never scaled (RFC 7323).
+    // The options are negotiated by the first SYN: a retransmitted one must not reset what was agreed.
+    const bool syn = msg.sender->SYN;
+    if ( syn and not our_ackno.has_value() ) {
+      peer_window_shift_
+        = cfg_.window_scale ? std::min( msg.sender->window_scale.value_or( 0 ), MAX_WINDOW_SHIFT ) : 0;
+      if ( !msg.sender->TSval ) {
+        sender_.disable_timestamps(); // only used if both SYNs carry them
+      }
+      if ( !msg.sender->window_scale ) {
+        sender_.withdraw_window_scale(); // a SYN-ACK may carry the option only if the SYN did (RFC 7323 2.2)
+      }
+      path_mss_ = path_mss( msg.sender->MSS );
+      sender_.set_max_payload_size( send_mss( cfg_.timestamps && msg.sender->TSval ) );
+    }
+
     // Give incoming TCPSenderMessage to receiver.
     receiver_.receive( std::move( msg.sender ) );
 
-    // Give incoming TCPReceiverMessage to sender.
-    sender_.receive( msg.receiver );
+    // Give incoming TCPReceiverMessage to sender, with the window scaled back up.
+    TCPReceiverMessage ack = msg.receiver.get();
+    ack.window_size <<= syn ? 0 : peer_window_shift_;
+    sender_.receive( ack );
+
+    if ( occupies_seqno ) {
+      ack_stats_.segments_received++;
+      const bool advanced = receiver_.send().ackno != our_ackno;
+      if ( delayable and advanced and ++unacked_segments_ < 2 ) {
+        ack_deadline_ = ack_deadline_.value_or( cumulative_time_ + cfg_.ack_delay );
+      } else {
+        need_send_ = true;
+      }
+    }
 
     // Send reply if needed.
     push( transmit );
@@ -77,7 +148,7 @@ public:
     }
 
     // Did the inbound stream finish before the outbound stream? If so, no need to linger after streams finish.
-    if ( receiver_.writer().is_closed() and not std::as_const( sender_ ).reader().is_finished() ) {
+    if ( receiver_.writer().is_closed() and not sender_.stream_sent() ) {
       linger_after_streams_finish_ = false;
     }
   }
@@ -86,19 +157,106 @@ public:
   const TCPReceiver& receiver() const { return receiver_; }
   const TCPSender& sender() const { return sender_; }
 
+  struct ACKStats
+  {
+    uint64_t segments_received; // segments that occupied sequence numbers
+    uint64_t pure_acks_sent;    // segments sent only to acknowledge (no data, SYN or FIN)
+    uint64_t delayed_acks_sent; // pure ACKs sent when the delayed-ACK timer ran out
+  };
+  const ACKStats& ack_stats() const { return ack_stats_; }
+
 private:
   TCPConfig cfg_;
-  TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_.isn, cfg_.rt_timeout };
+  TCPSender sender_ {
+    ByteStream { cfg_.send_capacity, ByteStream::Storage::Chunked }, cfg_.isn, cfg_.rt_timeout };
   TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity } } };
 
   bool need_send_ {};
 
   void send( const TCPSenderMessage& sender_message, const TransmitFunction& transmit )
   {
-    transmit( { borrow( sender_message ), receiver_.send() } );
+    // Whatever the segment carries, it acknowledges everything received so far
+    ack_stats_.pure_acks_sent += sender_message.sequence_length() == 0;
+    unacked_segments_ = 0;
+    ack_deadline_.reset();
+
+    // The segment header has 16 bits for the window: scale it down (except on a SYN)
+    TCPReceiverMessage ack = receiver_.send();
+    advertised_edge_ = receiver_.writer().bytes_pushed() + ack.window_size;
+    advertised_window_zero_ = ack.window_size == 0;
+    ack.window_size = sender_message.SYN ? std::min<uint32_t>( ack.window_size, UINT16_MAX )
+                                         : ack.window_size >> receiver_.window_scale();
+
+    // No room is reserved for SACK blocks in the payload size: drop the last ones rather than outgrow the path MSS
+    const auto segment_size = [&] {
+      const TCPMessage msg { borrow( sender_message ), borrow( ack ) };
+      return sender_message.payload.size() + TCPSegment::options_length( msg );
+    };
+    while ( not ack.sack.empty() and segment_size() > path_mss_ ) {
+      ack.sack.pop_back();
+    }
+    transmit( { borrow( sender_message ), std::move( ack ) } );
     need_send_ = false;
   }
 
+  // Delayed ACKs: how many segments have arrived since the last ACK, and when the timer runs out
+  uint64_t unacked_segments_ {};
+  std::optional<uint64_t> ack_deadline_ {};
+  ACKStats ack_stats_ {};
+
+  // The right edge of the last advertised window (as a stream index), and whether the window was zero
+  uint64_t advertised_edge_ {};
+  bool advertised_window_zero_ {};
+
+  // With delayed ACKs, the peer is told at once when the application frees half of the receive buffer (or any
+  // of it, after a zero window), rather than waiting for the next ACK or having to probe
+  bool window_opened() const
+  {
+    if ( not cfg_.ack_delay or not has_ackno() or receiver_.writer().is_closed() ) {
+      return false;
+    }
+    const uint64_t window = receiver_.send().window_size;
+    const uint64_t edge = receiver_.writer().bytes_pushed() + window;
+    const uint64_t capacity = receiver_.writer().available_capacity() + receiver_.reader().bytes_buffered();
+    return edge > advertised_edge_ and ( advertised_window_zero_ or edge - advertised_edge_ >= capacity / 2 );
+  }
+
+  // The largest payload that fits one datagram on our interface: announced to the peer as our MSS
+  uint16_t local_mss() const
+  {
+    return cfg_.mtu > TCPConfig::IPV4_TCP_HEADERS
+             ? static_cast<uint16_t>( std::min<size_t>( cfg_.mtu - TCPConfig::IPV4_TCP_HEADERS, UINT16_MAX ) )
+             : TCPConfig::MAX_PAYLOAD_SIZE;
+  }
+
+  // The largest segment, payload and options, that both ends can carry. Without the peer's MSS, stay at the
+  // conservative MAX_PAYLOAD_SIZE.
+  uint64_t path_mss( std::optional<uint16_t> peer_mss ) const
+  {
+    return std::min<uint64_t>( local_mss(), peer_mss.value_or( TCPConfig::MAX_PAYLOAD_SIZE ) );
+  }
+  uint64_t path_mss_ { path_mss( std::nullopt ) };
+
+  // The payload size to send: the path MSS less room for the timestamps riding on every data segment if both
+  // SYNs carried them. SACK blocks only go out while data is missing, so send() fits them into what room is left.
+  uint64_t send_mss( bool timestamps ) const
+  {
+    const uint64_t options = timestamps ? TCPSegment::TIMESTAMPS_OPTION_LENGTH : 0;
+    return path_mss_ > options ? path_mss_ - options : 1;
+  }
+
+  // Window scaling (RFC 7323): the smallest shift that lets the window cover `capacity`
+  static constexpr uint8_t MAX_WINDOW_SHIFT = 14;
+  static uint8_t window_shift_for( uint64_t capacity )
+  {
+    uint8_t shift = 0;
+    while ( shift < MAX_WINDOW_SHIFT && ( uint64_t { UINT16_MAX } << shift ) < capacity ) {
+      shift++;
+    }
+    return shift;
+  }
+  uint8_t peer_window_shift_ {}; // applied to the windows the peer advertises
+
   bool linger_after_streams_finish_ { true }; // one peer may need to linger to make sure all closure conditions met
   uint64_t cumulative_time_ {};
   uint64_t time_of_last_receipt_ {};
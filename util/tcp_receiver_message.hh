@@ -2,26 +2,45 @@
 
 #include "wrapping_integers.hh"
 
+#include <cstdint>
 #include <optional>
+#include <vector>
 
 /*
  * The TCPReceiverMessage structure contains the information sent from a TCP receiver to its sender.
  *
- * It contains three fields:
+ * It contains five fields:
  *
  * 1) The acknowledgment number (ackno): the *next* sequence number needed by the TCP Receiver.
  *    This is an optional field that is empty if the TCPReceiver hasn't yet received the Initial Sequence Number.
  *
  * 2) The window size. This is the number of sequence numbers that the TCP receiver is interested
  *    to receive, starting from the ackno if present. The maximum value is 65,535 (UINT16_MAX from
- *    the <cstdint> header).
+ *    the <cstdint> header), or 65,535 << 14 once window scaling (RFC 7323) has been negotiated.
+ *    (TCPPeer shifts it to fit the segment header's 16 bits, and back.)
  *
  * 3) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 4) Selective acknowledgments (RFC 2018): up to MAX_SACK_BLOCKS ranges of sequence numbers [left, right) past
+ *    the ackno that the receiver already holds. Only sent if the peer's SYN said SACK was permitted.
+ *
+ * 5) The timestamp echo (TSecr, RFC 7323): the TSval of the latest in-order segment from the peer, so that the
+ *    peer's sender can time the round trip. Only sent if both SYNs carried timestamps.
  */
 
+struct SACKBlock
+{
+  Wrap32 left { 0 };
+  Wrap32 right { 0 };
+};
+
 struct TCPReceiverMessage
 {
+  static constexpr size_t MAX_SACK_BLOCKS = 4;
+
   std::optional<Wrap32> ackno {};
-  uint16_t window_size {};
+  uint32_t window_size {};
   bool RST {};
+  std::vector<SACKBlock> sack {};
+  std::optional<uint32_t> TSecr {};
 };
@@ -3,12 +3,122 @@
 #include "helpers.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <sstream>
+#include <string_view>
 
 using namespace std;
 
 static_assert( !( TCPSegment::HEADER_LENGTH & 0x03 ) ); // header length must be divisible by 4
 
+namespace {
+
+// TCP option kinds
+constexpr uint8_t OPTION_END = 0;
+constexpr uint8_t OPTION_NOP = 1;
+constexpr uint8_t OPTION_MSS = 2;
+constexpr uint8_t OPTION_WINDOW_SCALE = 3;
+constexpr uint8_t OPTION_SACK_PERMITTED = 4;
+constexpr uint8_t OPTION_SACK = 5;
+constexpr uint8_t OPTION_TIMESTAMPS = 8;
+
+constexpr size_t MAX_OPTIONS_LENGTH = TCPSegment::MAX_OPTIONS_LENGTH;
+constexpr size_t SACK_BLOCK_LENGTH = 8;
+
+class Wrap32Serializable : public Wrap32
+{
+public:
+  uint32_t raw_value() const { return raw_value_; }
+};
+
+uint32_t read_u32( string_view bytes )
+{
+  uint32_t ret = 0;
+  for ( const char c : bytes.substr( 0, 4 ) ) {
+    ret = ret << 8 | static_cast<uint8_t>( c );
+  }
+  return ret;
+}
+
+// Length of the options other than SACK blocks (NOPs align the window scale and timestamps)
+size_t fixed_options_length( const TCPMessage& message )
+{
+  return ( message.sender->MSS ? 4 : 0 ) + ( message.sender->SACK_permitted ? 2 : 0 )
+         + ( message.sender->window_scale ? 4 : 0 )
+         + ( message.sender->TSval ? TCPSegment::TIMESTAMPS_OPTION_LENGTH : 0 );
+}
+
+// How many SACK blocks fit in the rest of the option space
+size_t sack_blocks_to_send( const TCPMessage& message )
+{
+  const size_t blocks = min( message.receiver->sack.size(), TCPReceiverMessage::MAX_SACK_BLOCKS );
+  return min( blocks, ( MAX_OPTIONS_LENGTH - fixed_options_length( message ) - 2 ) / SACK_BLOCK_LENGTH );
+}
+
+
+void parse_options( string_view options, TCPMessage& message )
+{
+  while ( !options.empty() ) {
+    const auto kind = static_cast<uint8_t>( options.front() );
+    if ( kind == OPTION_END ) {
+      return;
+    }
+    if ( kind == OPTION_NOP ) {
+      options.remove_prefix( 1 );
+      continue;
+    }
+    if ( options.size() < 2 || static_cast<uint8_t>( options[1] ) < 2
+         || static_cast<uint8_t>( options[1] ) > options.size() ) {
+      return; // malformed: ignore the rest
+    }
+    const auto body = options.substr( 2, static_cast<uint8_t>( options[1] ) - 2 );
+    options.remove_prefix( static_cast<uint8_t>( options[1] ) );
+
+    switch ( kind ) {
+      case OPTION_MSS:
+        if ( body.size() >= 2 ) {
+          message.sender->MSS = static_cast<uint16_t>( read_u32( body.substr( 0, 2 ) ) );
+        }
+        break;
+      case OPTION_SACK_PERMITTED:
+        message.sender->SACK_permitted = true;
+        break;
+      case OPTION_WINDOW_SCALE:
+        if ( !body.empty() ) {
+          message.sender->window_scale = static_cast<uint8_t>( body.front() );
+        }
+        break;
+      case OPTION_TIMESTAMPS:
+        if ( body.size() >= 8 ) {
+          message.sender->TSval = read_u32( body );
+          if ( message.receiver->ackno ) {
+            message.receiver->TSecr = read_u32( body.substr( 4 ) ); // only meaningful with the ACK flag
+          }
+        }
+        break;
+      case OPTION_SACK:
+        for ( size_t i = 0; i + SACK_BLOCK_LENGTH <= body.size(); i += SACK_BLOCK_LENGTH ) {
+          message.receiver->sack.push_back(
+            { Wrap32 { read_u32( body.substr( i ) ) }, Wrap32 { read_u32( body.substr( i + 4 ) ) } } );
+        }
+        break;
+      default:
+        break; // unknown option
+    }
+  }
+}
+
+} // namespace
+
+size_t TCPSegment::options_length( const TCPMessage& message )
+{
+  size_t len = fixed_options_length( message );
+  if ( const size_t blocks = sack_blocks_to_send( message ) ) {
+    len += 2 + blocks * SACK_BLOCK_LENGTH;
+  }
+  return ( len + 3 ) & ~size_t { 3 }; // padded to a multiple of 4 bytes
+}
+
 void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
 {
   /* verify checksum */
@@ -44,40 +154,86 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
   message.sender->SYN = octet & 0b0000'0010;
   message.sender->FIN = octet & 0b0000'0001;
 
-  parser.integer( message.receiver->window_size );
+  parser.integer( raw16 );
+  message.receiver->window_size = raw16;
   parser.integer( udinfo.cksum );
   parser.integer( raw16 ); // urgent pointer
 
-  // skip any options or anything extra in the header
+  // parse any options in the rest of the header
   if ( data_offset < ( HEADER_LENGTH >> 2 ) ) {
     parser.set_error();
     return;
   }
-  parser.remove_prefix( data_offset * 4 - HEADER_LENGTH );
+  if ( data_offset > ( HEADER_LENGTH >> 2 ) ) {
+    string options( data_offset * 4 - HEADER_LENGTH, 0 );
+    parser.string( options );
+    if ( parser.has_error() ) {
+      return;
+    }
+    parse_options( options, message );
+  }
 
   parser.concatenate_all_remaining( message.sender->payload );
 }
 
-class Wrap32Serializable : public Wrap32
-{
-public:
-  uint32_t raw_value() const { return raw_value_; }
-};
-
 void TCPSegment::serialize( Serializer& serializer ) const
 {
   serializer.integer( udinfo.src_port );
   serializer.integer( udinfo.dst_port );
   serializer.integer( Wrap32Serializable { message.sender->seqno }.raw_value() );
   serializer.integer( Wrap32Serializable { message.receiver->ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
-  serializer.integer( uint8_t { ( HEADER_LENGTH >> 2 ) << 4 } ); // data offset
+  const size_t options_len = options_length( message );
+  serializer.integer( static_cast<uint8_t>( ( ( HEADER_LENGTH + options_len ) >> 2 ) << 4 ) ); // data offset
   const bool reset = message.sender->RST or message.receiver->RST;
   const uint8_t flags = ( message.receiver->ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
                         | ( message.sender->SYN ? 0b0000'0010U : 0 ) | ( message.sender->FIN ? 0b0000'0001U : 0 );
   serializer.integer( flags );
-  serializer.integer( message.receiver->window_size );
+  serializer.integer( static_cast<uint16_t>( min<uint32_t>( message.receiver->window_size, UINT16_MAX ) ) );
   serializer.integer( udinfo.cksum );
   serializer.integer( uint16_t { 0 } ); // urgent pointer
+
+  // options, padded with End of Option List
+  size_t written = 0;
+  if ( message.sender->MSS ) {
+    serializer.integer( OPTION_MSS );
+    serializer.integer( uint8_t { 4 } );
+    serializer.integer( *message.sender->MSS );
+    written += 4;
+  }
+  if ( message.sender->SACK_permitted ) {
+    serializer.integer( OPTION_SACK_PERMITTED );
+    serializer.integer( uint8_t { 2 } );
+    written += 2;
+  }
+  if ( message.sender->window_scale ) {
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_WINDOW_SCALE );
+    serializer.integer( uint8_t { 3 } );
+    serializer.integer( *message.sender->window_scale );
+    written += 4;
+  }
+  if ( message.sender->TSval ) {
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_TIMESTAMPS );
+    serializer.integer( uint8_t { 10 } );
+    serializer.integer( *message.sender->TSval );
+    serializer.integer( message.receiver->TSecr.value_or( 0 ) );
+    written += TCPSegment::TIMESTAMPS_OPTION_LENGTH;
+  }
+  if ( const size_t blocks = sack_blocks_to_send( message ) ) {
+    serializer.integer( OPTION_SACK );
+    serializer.integer( static_cast<uint8_t>( 2 + blocks * SACK_BLOCK_LENGTH ) );
+    for ( size_t i = 0; i < blocks; i++ ) {
+      serializer.integer( Wrap32Serializable { message.receiver->sack[i].left }.raw_value() );
+      serializer.integer( Wrap32Serializable { message.receiver->sack[i].right }.raw_value() );
+    }
+    written += 2 + blocks * SACK_BLOCK_LENGTH;
+  }
+  for ( ; written < options_len; written++ ) {
+    serializer.integer( OPTION_END );
+  }
+
   serializer.buffer( message.sender->payload );
 }
 
@@ -114,6 +270,22 @@ string TCPSegment::to_string() const
     ss << " ACK<" << Wrap32Serializable { *ackno }.raw_value() << ">";
   }
   ss << " winsize=" << message.receiver->window_size;
+  if ( message.sender->MSS ) {
+    ss << " MSS=" << *message.sender->MSS;
+  }
+  if ( message.sender->SACK_permitted ) {
+    ss << " +SACK_PERMITTED";
+  }
+  if ( message.sender->window_scale ) {
+    ss << " WS=" << static_cast<int>( *message.sender->window_scale );
+  }
+  if ( message.sender->TSval ) {
+    ss << " TS<" << *message.sender->TSval << "," << message.receiver->TSecr.value_or( 0 ) << ">";
+  }
+  for ( const auto& block : message.receiver->sack ) {
+    ss << " SACK<" << Wrap32Serializable { block.left }.raw_value() << ","
+       << Wrap32Serializable { block.right }.raw_value() << ">";
+  }
   ss << " src=" << udinfo.src_port << " dst=" << udinfo.dst_port;
   return ss.str();
 }
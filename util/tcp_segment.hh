@@ -27,7 +27,12 @@ struct TCPSegment
 
   void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
 
-  static constexpr uint8_t HEADER_LENGTH = 20; // TCP header length, not including options
+  static constexpr uint8_t HEADER_LENGTH = 20;      // TCP header length, not including options
+  static constexpr uint8_t MAX_OPTIONS_LENGTH = 40; // room for options after the header
+  static constexpr uint8_t TIMESTAMPS_OPTION_LENGTH = 12; // RFC 7323 timestamps, aligned by two NOPs
+
+  // Length of the options that serialize() writes for `message`, padding included
+  static size_t options_length( const TCPMessage& message );
 
   // Return a string containing a summary in human-readable format
   std::string to_string() const;
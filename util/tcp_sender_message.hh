@@ -2,12 +2,14 @@
 
 #include "wrapping_integers.hh"
 
+#include <cstdint>
+#include <optional>
 #include <string>
 
 /*
  * The TCPSenderMessage structure contains the information sent from a TCP sender to its receiver.
  *
- * It contains five fields:
+ * It contains seven fields:
  *
  * 1) The sequence number (seqno) of the beginning of the segment. If the SYN flag is set, this is the
  *    sequence number of the SYN flag. Otherwise, it's the sequence number of the beginning of the payload.
@@ -20,6 +22,12 @@
  * 4) The FIN flag. If set, the payload represents the ending of the byte stream.
  *
  * 5) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 6) Options negotiated on the SYN: whether the sender will accept selective acknowledgments (RFC 2018),
+ *    the shift count its side of the connection applies to the windows it advertises (RFC 7323), and the
+ *    largest segment payload its side can receive (the MSS, RFC 9293).
+ *
+ * 7) The timestamp (TSval, RFC 7323): the sender's clock when the segment was sent, which the peer echoes back.
  */
 
 struct TCPSenderMessage
@@ -32,6 +40,12 @@ struct TCPSenderMessage
 
   bool RST {};
 
+  bool SACK_permitted {};
+  std::optional<uint8_t> window_scale {};
+  std::optional<uint16_t> MSS {};
+
+  std::optional<uint32_t> TSval {};
+
   // How many sequence numbers does this segment use?
   size_t sequence_length() const { return SYN + payload.size() + FIN; }
 };
@@ -6,6 +6,7 @@
 #include <linux/if.h>
 #include <linux/if_tun.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
 
 static constexpr const char* CLONEDEV = "/dev/net/tun";
 
@@ -35,4 +36,20 @@ TunTapFD::TunTapFD( const string& devname, const bool is_tun )
   tun_req.ifr_name[IFNAMSIZ - 1] = '\0';
 
   CheckSystemCall( "ioctl", ioctl( fd_num(), TUNSETIFF, static_cast<void*>( &tun_req ) ) );
+
+  // the kernel returns the name of the device actually attached (e.g. "tun0" for a request of "tun%d")
+  devname_ = static_cast<const char*>( tun_req.ifr_name );
+}
+
+size_t TunTapFD::mtu() const
+{
+  struct ifreq mtu_req
+  {};
+  strncpy( static_cast<char*>( mtu_req.ifr_name ), devname_.data(), IFNAMSIZ - 1 );
+  mtu_req.ifr_name[IFNAMSIZ - 1] = '\0';
+
+  // SIOCGIFMTU needs a socket, not the TUN/TAP file descriptor
+  const FileDescriptor sock { ::CheckSystemCall( "socket", socket( AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0 ) ) };
+  CheckSystemCall( "ioctl", ioctl( sock.fd_num(), SIOCGIFMTU, static_cast<void*>( &mtu_req ) ) );
+  return static_cast<size_t>( mtu_req.ifr_mtu );
 }
@@ -11,6 +11,12 @@ public:
   //! Open an existing persistent [TUN or TAP
   //! device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
   explicit TunTapFD( const std::string& devname, bool is_tun );
+
+  //! The device's MTU (the largest datagram or frame payload it carries), as set with `ip link set mtu`
+  size_t mtu() const;
+
+private:
+  std::string devname_ {}; // as returned by TUNSETIFF
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device